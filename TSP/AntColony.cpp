@@ -0,0 +1,240 @@
+// Copyright 2020 GHA Test Team
+#include "AntColony.h"
+#include "KDTree.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cmath>
+
+struct AntColony::Worker {
+  UnvisitedCities cities;
+  Random rng;
+  std::vector<float> row;
+  // open[city] is 1 while city is unvisited, 0 after: the mask of the
+  // roulette row as floats, so that it is read with a vector gather.
+  std::vector<float> open;
+  std::vector<long> tour;
+  std::vector<long> best_tour;
+  double best_cost;
+  long best_ant;
+
+  Worker(const KDTree& tree, long size, long k)
+    : cities(tree), row(k), open(size), tour(size), best_tour(size) {}
+};
+
+AntColony::AntColony(DataReader* reader) : reader(reader), size(reader->node_num) {
+  if (reader->dist_matrix != nullptr)
+    owned_distance.reset(new MatrixDistance(reader->dist_matrix));
+  else
+    owned_distance.reset(makeDistance(reader->data, reader->edge_weight_type));
+  distance = owned_distance.get();
+  best_cost = std::numeric_limits<double>::infinity();
+}
+
+AntColony::~AntColony() {}
+
+// Builds everything that depends on the parameters; called by the first
+// run().
+void AntColony::setup() {
+  tree.reset(new KDTree(reader->data));
+  k = std::max(1L, std::min(candidates, size - 1));
+  neighbours.resize(size * k);
+  heuristic.resize(size * k);
+  for (long city = 0; city < size; city++) {
+    tree->nearest(city, k, neighbours.data() + city * k);
+    for (long m = 0; m < k; m++) {
+      double length = std::max(distance->distance(city, neighbours[city * k + m]), 1e-9);
+      heuristic[city * k + m] = (float)std::pow(1.0 / length, beta);
+    }
+  }
+
+  // The greedy tour is the first best tour and sets the pheromone bounds.
+  polisher.reset(new TSP(distance, size));
+  polisher->use_candidates = true;
+  polisher->use_dont_look_bits = true;
+  polisher->buildCandidateLists(reader->data, 8);
+  polisher->createGreedyEdgeTour(reader->data, 8);
+  best_cost = polisher->getPathCost();
+  best_path.assign(polisher->getPath(), polisher->getPath() + size);
+
+  tau_max = (float)(1.0 / (evaporation * best_cost));
+  tau_min = tau_max / (2.0f * size);
+  pheromone.assign(size * k, tau_max);
+  weight.resize(size * k);
+  updateWeights();
+
+  pool.reset(new ThreadPool(threads));
+  workers.clear();
+  for (long w = 0; w < pool->getThreads(); w++)
+    workers.emplace_back(new Worker(*tree, size, k));
+}
+
+void AntColony::updateWeights() {
+  long count = size * k;
+  if (alpha == 1.0) {
+    for (long i = 0; i < count; i++)
+      weight[i] = pheromone[i] * heuristic[i];
+    return;
+  }
+  for (long i = 0; i < count; i++)
+    weight[i] = (float)std::pow(pheromone[i], alpha) * heuristic[i];
+}
+
+// Evaporates the whole store, deposits 1 / cost on both directions of
+// every tour edge that is a candidate edge, and clamps to the bounds.
+void AntColony::updatePheromone(const std::vector<long>& tour, double cost) {
+  float keep = (float)(1.0 - evaporation);
+  long count = size * k;
+  for (long i = 0; i < count; i++)
+    pheromone[i] = std::max(tau_min, pheromone[i] * keep);
+
+  float amount = (float)(1.0 / cost);
+  auto deposit = [&](long a, long b) {
+    const long* cand = neighbours.data() + a * k;
+    for (long m = 0; m < k; m++) {
+      if (cand[m] == b) {
+        float& value = pheromone[a * k + m];
+        value = std::min(tau_max, value + amount);
+        return;
+      }
+    }
+  };
+  for (long i = 0; i < size; i++) {
+    long a = tour[i], b = tour[i + 1 == size ? 0 : i + 1];
+    deposit(a, b);
+    deposit(b, a);
+  }
+}
+
+// row[m] = w[m] * open[cand[m]]: visited candidates get weight 0. The loop
+// has no branch, and with the restrict pointers and the int index the
+// compiler vectorizes it with 32-bit float gathers.
+static void maskedRow(float* __restrict row, const float* __restrict w, const float* __restrict open,
+                      const long* __restrict cand, long k) {
+  for (long m = 0; m < k; m++)
+    row[m] = w[m] * open[(int)cand[m]];
+}
+
+double AntColony::buildTour(Worker& worker, long ant) {
+  worker.rng.seed(seed, ((unsigned long long)iteration << 32) | (unsigned long long)ant);
+  UnvisitedCities& cities = worker.cities;
+  float* row = worker.row.data();
+  float* open = worker.open.data();
+  cities.reset();
+  std::fill(open, open + size, 1.0f);
+
+  long city = worker.rng.below(size);
+  cities.remove(city);
+  open[city] = 0.0f;
+  worker.tour[0] = city;
+  double cost = 0.0;
+
+  for (long step = 1; step < size; step++) {
+    const long* cand = neighbours.data() + city * k;
+    const float* w = weight.data() + city * k;
+    maskedRow(row, w, open, cand, k);
+
+    long chosen = -1;
+    if (worker.rng.uniform() < exploit) {
+      long best = 0;
+      for (long m = 1; m < k; m++)
+        best = row[m] > row[best] ? m : best;
+      if (row[best] > 0.0f)
+        chosen = best;
+    }
+    else {
+      // Running sums; the pick is the first candidate whose sum exceeds
+      // r, i.e. the number of sums not above it. Only candidates with a
+      // positive weight raise the sum, so only they can be picked.
+      for (long m = 1; m < k; m++)
+        row[m] += row[m - 1];
+      float total = row[k - 1];
+      if (total > 0.0f) {
+        float r = (float)worker.rng.uniform() * total;
+        if (!(r < total))
+          r = std::nextafter(total, 0.0f);
+        chosen = 0;
+        for (long m = 0; m < k; m++)
+          chosen += row[m] <= r;
+      }
+    }
+    long next = chosen != -1 ? cand[chosen] : cities.nearest(city);
+
+    cities.remove(next);
+    open[next] = 0.0f;
+    worker.tour[step] = next;
+    cost += distance->distance(city, next);
+    city = next;
+  }
+  return cost + distance->distance(city, worker.tour[0]);
+}
+
+void AntColony::run(long iterations, double seconds) {
+  if (size < 3 || ants < 1)
+    return;
+  if (!tree)
+    setup();
+  auto start = std::chrono::steady_clock::now();
+
+  for (long it = 0; iterations < 0 || it < iterations; it++) {
+    if (seconds >= 0) {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() >= seconds)
+        break;
+    }
+
+    for (auto& worker : workers) {
+      worker->best_cost = std::numeric_limits<double>::infinity();
+      worker->best_ant = -1;
+    }
+    pool->parallelFor(0, ants, 1, [this](long w, long lo, long hi) {
+      Worker& worker = *workers[w];
+      for (long ant = lo; ant < hi; ant++) {
+        double cost = buildTour(worker, ant);
+        if (cost < worker.best_cost) {
+          worker.best_cost = cost;
+          worker.best_ant = ant;
+          worker.best_tour.swap(worker.tour);
+        }
+      }
+    });
+
+    // Ties go to the lowest ant, as in a sequential run.
+    Worker* found = nullptr;
+    for (auto& worker : workers) {
+      if (worker->best_ant == -1)
+        continue;
+      if (found == nullptr || worker->best_cost < found->best_cost ||
+          (worker->best_cost == found->best_cost && worker->best_ant < found->best_ant))
+        found = worker.get();
+    }
+    std::vector<long>& tour = found->best_tour;
+    double cost = found->best_cost;
+
+    if (polish) {
+      polisher->setPath(tour.data());
+      polisher->iteratedLocalSearch(reader, "");
+      std::copy(polisher->getPath(), polisher->getPath() + size, tour.begin());
+      cost = polisher->getPathCost();
+    }
+
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_path = tour;
+      tau_max = (float)(1.0 / (evaporation * best_cost));
+      tau_min = tau_max / (2.0f * size);
+    }
+
+    // Every fifth iteration the best tour so far is reinforced instead of
+    // the iteration's one.
+    if (iteration % 5 == 4)
+      updatePheromone(best_path, best_cost);
+    else
+      updatePheromone(tour, cost);
+    updateWeights();
+    iteration++;
+  }
+}
+
+void AntColony::savePath(std::string file_name) {
+  reader->SavePath(file_name, best_path.data(), best_cost, size);
+}
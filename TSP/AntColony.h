@@ -0,0 +1,80 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_ANTCOLONY_H_
+#define INCLUDE_ANTCOLONY_H_
+#include <memory>
+#include <string>
+#include <vector>
+#include "TSPAlgorithm.h"
+
+class ThreadPool;
+class KDTree;
+
+// MAX-MIN ant system over the candidate lists of the cities. Pheromone and
+// choice weights are stored flat, weight[city * k + m] for the m-th
+// candidate of city, and an ant picks among the unvisited candidates with
+// a roulette over that row (or takes the heaviest one with probability
+// `exploit`): the row is masked and summed, and the pick counted, without
+// branches. When every candidate is visited it moves to the
+// nearest unvisited city through a kd-tree. The ants of an iteration run
+// in parallel, each seeded from (seed, iteration, ant), so a run does not
+// depend on the thread count. Evaporation and reinforcement are applied
+// to the whole store once per iteration, and the iteration's best tour can
+// be polished with the TSP 2-opt search before it is deposited.
+class AntColony {
+public:
+  // Ants per iteration; run() does nothing below 1.
+  long ants = 32;
+  double alpha = 1.0;
+  double beta = 2.0;
+  double evaporation = 0.2;
+  double exploit = 0.9;
+  long candidates = 15;
+  // 0 = one worker per hardware thread.
+  long threads = 0;
+  bool polish = true;
+  unsigned long long seed = 1;
+
+  // Uses reader's distance matrix when it was built, matrix-free distances
+  // for its edge weight type otherwise.
+  explicit AntColony(DataReader* reader);
+  ~AntColony();
+  AntColony(const AntColony&) = delete;
+  AntColony& operator=(const AntColony&) = delete;
+
+  // Runs until `iterations` iterations (-1 = no limit) or `seconds`
+  // (-1 = no limit) have passed. Can be called again to continue.
+  void run(long iterations, double seconds = -1);
+  const std::vector<long>& getBestPath() const { return best_path; }
+  double getBestCost() const { return best_cost; }
+  void savePath(std::string file_name);
+
+private:
+  struct Worker;
+
+  DataReader* reader;
+  long size;
+  std::unique_ptr<DistanceProvider> owned_distance;
+  const DistanceProvider* distance;
+  std::unique_ptr<KDTree> tree;
+  std::unique_ptr<TSP> polisher;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  long k = 0;
+  std::vector<long> neighbours;
+  std::vector<float> heuristic;
+  std::vector<float> pheromone;
+  std::vector<float> weight;
+  float tau_min = 0.0f, tau_max = 0.0f;
+  long iteration = 0;
+
+  std::vector<long> best_path;
+  double best_cost;
+
+  void setup();
+  double buildTour(Worker& worker, long ant);
+  void updatePheromone(const std::vector<long>& tour, double cost);
+  void updateWeights();
+};
+
+#endif  // INCLUDE_ANTCOLONY_H_
@@ -0,0 +1,149 @@
+// Copyright 2020 GHA Test Team
+#include "CheckpointWriter.h"
+#include "TSPAlgorithm.h"
+#include <cstdint>
+#include <cstdio>
+
+
+CheckpointWriter::CheckpointWriter(const DataReader* reader, double interval_seconds,
+                                   double min_improvement, Format format)
+  : reader(reader),
+    interval(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval_seconds))),
+    min_improvement(min_improvement), format(format) {
+  worker = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  worker.join();
+}
+
+void CheckpointWriter::submit(const std::string& file_name, const long* path, long size, double cost) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot& snapshot = files[file_name];
+    snapshot.path.assign(path, path + size);
+    snapshot.cost = cost;
+    if (!snapshot.pending) {
+      snapshot.pending = true;
+      pending++;
+    }
+  }
+  wake.notify_one();
+}
+
+void CheckpointWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  flushing = true;
+  wake.notify_one();
+  idle.wait(lock, [this] { return pending == 0; });
+  flushing = false;
+}
+
+unsigned long long CheckpointWriter::getBytesWritten() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return bytes_written;
+}
+
+bool CheckpointWriter::isDue(const Snapshot& snapshot, Clock::time_point now) const {
+  if (!snapshot.written || now - snapshot.written_at >= interval)
+    return true;
+  return min_improvement > 0 && snapshot.written_cost - snapshot.cost >= min_improvement;
+}
+
+// Writes into a temporary file and renames it over the target, so a
+// reader never sees a half-written checkpoint.
+unsigned long long CheckpointWriter::write(const std::string& file_name, const std::vector<long>& path, double cost) {
+  TSP_PHASE(Checkpoint);
+  std::string temp_name = file_name + ".tmp";
+  unsigned long long bytes = 0;
+
+  if (format == Format::Text) {
+    std::ofstream out(temp_name);
+    if (!out.is_open())
+      return 0;
+    for (long city : path)
+      out << reader->data[city].id << " ";
+    out << "COST: " << " " << cost << std::endl;
+    bytes = out.tellp();
+  }
+  else {
+    // "TSPC", int64 size, double cost, int32 city ids.
+    std::ofstream out(temp_name, std::ios::binary);
+    if (!out.is_open())
+      return 0;
+    int64_t size = path.size();
+    std::vector<int32_t> ids(path.size());
+    for (size_t i = 0; i < path.size(); i++)
+      ids[i] = (int32_t)reader->data[path[i]].id;
+    out.write("TSPC", 4);
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(&cost), sizeof(cost));
+    out.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(int32_t));
+    bytes = out.tellp();
+  }
+
+  // rename replaces the checkpoint atomically on POSIX. Windows refuses
+  // to rename over an existing file, so only when rename fails is the old
+  // checkpoint removed first.
+  if (std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+    std::remove(file_name.c_str());
+    if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+      return 0;
+  }
+  TSP_COUNT(CheckpointBytes, bytes);
+  return bytes;
+}
+
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  std::vector<long> path;
+
+  while (true) {
+    Clock::time_point now = Clock::now();
+    Clock::time_point next_due = Clock::time_point::max();
+    bool wrote = false;
+
+    for (auto& entry : files) {
+      Snapshot& snapshot = entry.second;
+      if (!snapshot.pending)
+        continue;
+      if (!(flushing || stopping) && !isDue(snapshot, now)) {
+        next_due = std::min(next_due, snapshot.written_at + interval);
+        continue;
+      }
+
+      // Take the snapshot and write it without holding the lock.
+      path.swap(snapshot.path);
+      double cost = snapshot.cost;
+      snapshot.pending = false;
+      snapshot.written = true;
+      snapshot.written_cost = cost;
+      snapshot.written_at = now;
+      pending--;
+      std::string file_name = entry.first;
+
+      lock.unlock();
+      unsigned long long bytes = write(file_name, path, cost);
+      lock.lock();
+      bytes_written += bytes;
+      wrote = true;
+    }
+
+    if (pending == 0)
+      idle.notify_all();
+    if (wrote)
+      continue;
+    if (stopping && pending == 0)
+      return;
+
+    if (next_due == Clock::time_point::max())
+      wake.wait(lock);
+    else
+      wake.wait_until(lock, next_due);
+  }
+}
@@ -0,0 +1,66 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_CHECKPOINTWRITER_H_
+#define INCLUDE_CHECKPOINTWRITER_H_
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class DataReader;
+
+// Writes tour snapshots from a background thread so that the search never
+// waits for the disk. Snapshots for the same file are coalesced (the latest
+// wins); a file is rewritten at most once per interval unless its cost
+// dropped by at least min_improvement since the last write. Pending
+// snapshots are flushed on destruction.
+class CheckpointWriter {
+public:
+  enum class Format { Text, Binary };
+
+  CheckpointWriter(const DataReader* reader, double interval_seconds = 1.0,
+                   double min_improvement = 0.0, Format format = Format::Text);
+  ~CheckpointWriter();
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  // Copies the tour; safe to call from several search threads.
+  void submit(const std::string& file_name, const long* path, long size, double cost);
+  // Blocks until every pending snapshot is on disk.
+  void flush();
+  unsigned long long getBytesWritten() const;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  struct Snapshot {
+    std::vector<long> path;
+    double cost;
+    bool pending = false;
+    bool written = false;
+    double written_cost = 0.0;
+    Clock::time_point written_at;
+  };
+
+  const DataReader* reader;
+  Clock::duration interval;
+  double min_improvement;
+  Format format;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  std::map<std::string, Snapshot> files;
+  long pending = 0;
+  bool flushing = false;
+  bool stopping = false;
+  unsigned long long bytes_written = 0;
+  std::thread worker;
+
+  bool isDue(const Snapshot& snapshot, Clock::time_point now) const;
+  unsigned long long write(const std::string& file_name, const std::vector<long>& path, double cost);
+  void run();
+};
+
+#endif  // INCLUDE_CHECKPOINTWRITER_H_
@@ -0,0 +1,436 @@
+// Copyright 2020 GHA Test Team
+#include "Decomposition.h"
+#include "KDTree.h"
+#include "ThreadPool.h"
+#include <numeric>
+
+// Distances of a tour window whose first and last cities must stay joined:
+// their edge costs `fixed`, low enough that no move ever removes it.
+class FixedEdgeDistance : public DistanceProvider {
+private:
+  const DistanceProvider* base;
+  long first, last;
+  double fixed;
+
+public:
+  FixedEdgeDistance(const DistanceProvider* base, long first, long last, double fixed)
+    : base(base), first(first), last(last), fixed(fixed) {}
+  double distance(long a, long b) const override {
+    if ((a == first && b == last) || (a == last && b == first))
+      return fixed;
+    return base->distance(a, b);
+  }
+};
+
+Decomposition::Decomposition(DataReader* reader) : reader(reader), size(reader->node_num) {}
+
+Decomposition::~Decomposition() {}
+
+static double planeDistance(const node_info& a, double x, double y) {
+  double dx = a.x - x, dy = a.y - y;
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+static node_info centroid(const std::vector<node_info>& data, const std::vector<long>& part) {
+  node_info center = {0, 0.0, 0.0};
+  for (long city : part) {
+    center.x += data[city].x;
+    center.y += data[city].y;
+  }
+  center.x /= part.size();
+  center.y /= part.size();
+  return center;
+}
+
+// Median splits across the wider side of the bounding box until every
+// range has at most part_size cities.
+void Decomposition::splitKDTree() {
+  const std::vector<node_info>& data = reader->data;
+  std::vector<long> order(size);
+  std::iota(order.begin(), order.end(), 0L);
+  long limit = std::max(1L, this->part_size);
+
+  parts.clear();
+  std::vector<std::pair<long, long>> ranges(1, std::make_pair(0L, size));
+  while (!ranges.empty()) {
+    long lo = ranges.back().first, hi = ranges.back().second;
+    ranges.pop_back();
+    if (hi - lo <= limit) {
+      parts.emplace_back(order.begin() + lo, order.begin() + hi);
+      continue;
+    }
+
+    double min_x = data[order[lo]].x, max_x = min_x;
+    double min_y = data[order[lo]].y, max_y = min_y;
+    for (long i = lo + 1; i < hi; i++) {
+      const node_info& node = data[order[i]];
+      min_x = std::min(min_x, node.x);
+      max_x = std::max(max_x, node.x);
+      min_y = std::min(min_y, node.y);
+      max_y = std::max(max_y, node.y);
+    }
+    bool by_x = max_x - min_x >= max_y - min_y;
+    long mid = lo + (hi - lo) / 2;
+    std::nth_element(order.begin() + lo, order.begin() + mid, order.begin() + hi,
+                     [&](long a, long b) { return by_x ? data[a].x < data[b].x : data[a].y < data[b].y; });
+    ranges.emplace_back(mid, hi);
+    ranges.emplace_back(lo, mid);
+  }
+}
+
+// Lloyd iterations from the k-d parts. A city only compares the centre
+// of its part with the centres nearest to that one, so an iteration is
+// O(n) rather than O(n * parts). Parts that run empty are dropped.
+void Decomposition::refineKMeans() {
+  const std::vector<node_info>& data = reader->data;
+  long m = parts.size();
+  if (m < 2)
+    return;
+
+  std::vector<node_info> centers(m);
+  part_of.assign(size, 0);
+  for (long p = 0; p < m; p++) {
+    centers[p] = centroid(data, parts[p]);
+    centers[p].id = p + 1;
+    for (long city : parts[p])
+      part_of[city] = p;
+  }
+
+  long near_k = std::min(8L, m - 1);
+  std::vector<long> near(m * near_k);
+  std::vector<long> changes(pool->getThreads());
+  for (long iteration = 0; iteration < this->kmeans_iterations; iteration++) {
+    KDTree tree(centers);
+    for (long p = 0; p < m; p++)
+      tree.nearest(p, near_k, near.data() + p * near_k);
+
+    std::fill(changes.begin(), changes.end(), 0L);
+    pool->parallelFor(0, size, 4096, [&](long w, long lo, long hi) {
+      for (long city = lo; city < hi; city++) {
+        long own = part_of[city], best = own;
+        double best_dist = planeDistance(data[city], centers[own].x, centers[own].y);
+        for (long n = 0; n < near_k; n++) {
+          long p = near[own * near_k + n];
+          double d = planeDistance(data[city], centers[p].x, centers[p].y);
+          if (d < best_dist) {
+            best_dist = d;
+            best = p;
+          }
+        }
+        if (best != own) {
+          part_of[city] = best;
+          changes[w]++;
+        }
+      }
+    });
+    if (std::accumulate(changes.begin(), changes.end(), 0L) == 0)
+      break;
+
+    std::vector<double> sum_x(m, 0.0), sum_y(m, 0.0);
+    std::vector<long> count(m, 0);
+    for (long city = 0; city < size; city++) {
+      sum_x[part_of[city]] += data[city].x;
+      sum_y[part_of[city]] += data[city].y;
+      count[part_of[city]]++;
+    }
+    for (long p = 0; p < m; p++) {
+      if (count[p] == 0)
+        continue;
+      centers[p].x = sum_x[p] / count[p];
+      centers[p].y = sum_y[p] / count[p];
+    }
+  }
+
+  parts.assign(m, std::vector<long>());
+  for (long city = 0; city < size; city++)
+    parts[part_of[city]].push_back(city);
+  parts.erase(std::remove_if(parts.begin(), parts.end(),
+                             [](const std::vector<long>& part) { return part.empty(); }),
+              parts.end());
+}
+
+// Puts the parts in the order of a short tour over their centroids.
+void Decomposition::orderParts() {
+  long m = parts.size();
+  if (m < 4)
+    return;
+  std::vector<node_info> centers(m);
+  for (long p = 0; p < m; p++) {
+    centers[p] = centroid(reader->data, parts[p]);
+    centers[p].id = p + 1;
+  }
+
+  MetricDistance<EuclideanFormula> distance(centers);
+  TSP tsp(&distance, m);
+  long k = std::min(8L, m - 1);
+  tsp.use_candidates = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_or_opt = true;
+  tsp.buildCandidateLists(centers, k);
+  tsp.createGreedyEdgeTour(centers, k);
+  tsp.iteratedLocalSearch(nullptr, "");
+
+  std::vector<std::vector<long>> ordered(m);
+  for (long p = 0; p < m; p++)
+    ordered[p].swap(parts[tsp.getPath()[p]]);
+  parts.swap(ordered);
+}
+
+// Greedy edge tour of the part and the engine's local search on it, with
+// distances and candidate lists over the part's cities only. Returns the
+// tour in global city numbers.
+std::vector<long> Decomposition::solvePart(long p) const {
+  const std::vector<long>& part = parts[p];
+  long count = part.size();
+  if (count < 8)
+    return part;
+
+  std::vector<node_info> data(count);
+  for (long i = 0; i < count; i++)
+    data[i] = reader->data[part[i]];
+  std::unique_ptr<DistanceProvider> distance(makeDistance(data, reader->edge_weight_type));
+
+  TSP tsp(distance.get(), count);
+  tsp.random = Random(this->seed, p + 1);
+  tsp.use_candidates = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_or_opt = this->use_or_opt;
+  tsp.use_lin_kernighan = this->use_lin_kernighan;
+  tsp.buildCandidateLists(data, this->candidates);
+  tsp.createGreedyEdgeTour(data, this->candidates);
+  if (this->part_kicks > 0)
+    tsp.iteratedKickSearch(nullptr, "", this->part_kicks);
+  else
+    tsp.iteratedLocalSearch(nullptr, "");
+
+  std::vector<long> tour(count);
+  for (long i = 0; i < count; i++)
+    tour[i] = part[tsp.getPath()[i]];
+  return tour;
+}
+
+// Walks the parts in order. Each part tour is opened at the edge (a, b)
+// that minimizes d(exit of the previous part, a) - d(a, b) + d(b, next
+// part), with the next part's centroid standing in for its entry (the
+// first part uses the last part's centroid as well). Plane distances
+// are used throughout.
+void Decomposition::stitch(const std::vector<std::vector<long>>& tours) {
+  const std::vector<node_info>& data = reader->data;
+  long m = tours.size();
+  path.clear();
+  path.reserve(size);
+  if (m == 1) {
+    path = tours[0];
+    return;
+  }
+
+  std::vector<node_info> centers(m);
+  for (long p = 0; p < m; p++)
+    centers[p] = centroid(data, parts[p]);
+
+  double exit_x = centers[m - 1].x, exit_y = centers[m - 1].y;
+  long first_city = -1;
+  for (long p = 0; p < m; p++) {
+    const std::vector<long>& tour = tours[p];
+    long count = tour.size();
+    const node_info& target = p + 1 < m ? centers[p + 1] : data[first_city];
+
+    long best_in = 0;
+    bool forward = true;
+    double best = std::numeric_limits<double>::infinity();
+    for (long i = 0; i < count && count > 1; i++) {
+      const node_info& a = data[tour[i]];
+      const node_info& b = data[tour[i + 1 == count ? 0 : i + 1]];
+      double edge = planeDistance(a, b.x, b.y);
+      // In at a, out at b: the part is walked backwards from a.
+      double cost = planeDistance(a, exit_x, exit_y) + planeDistance(b, target.x, target.y) - edge;
+      if (cost < best) {
+        best = cost;
+        best_in = i;
+        forward = false;
+      }
+      // In at b, out at a: walked forwards from b.
+      cost = planeDistance(b, exit_x, exit_y) + planeDistance(a, target.x, target.y) - edge;
+      if (cost < best) {
+        best = cost;
+        best_in = i + 1 == count ? 0 : i + 1;
+        forward = true;
+      }
+    }
+
+    for (long step = 0; step < count; step++)
+      path.push_back(tour[(best_in + (forward ? step : count - step)) % count]);
+    if (p == 0)
+      first_city = path.front();
+    exit_x = data[path.back()].x;
+    exit_y = data[path.back()].y;
+  }
+}
+
+// Re-optimizes the stretch of cities as a path from its first to its
+// last city, which stay in place. Returns false when nothing improved.
+bool Decomposition::solveWindow(std::vector<long>& cities) const {
+  long count = cities.size();
+  std::vector<node_info> data(count);
+  double min_x = reader->data[cities[0]].x, max_x = min_x;
+  double min_y = reader->data[cities[0]].y, max_y = min_y;
+  for (long i = 0; i < count; i++) {
+    data[i] = reader->data[cities[i]];
+    min_x = std::min(min_x, data[i].x);
+    max_x = std::max(max_x, data[i].x);
+    min_y = std::min(min_y, data[i].y);
+    max_y = std::max(max_y, data[i].y);
+  }
+  std::unique_ptr<DistanceProvider> base(makeDistance(data, reader->edge_weight_type));
+  double span = std::max(1.0, std::max(max_x - min_x, max_y - min_y));
+  FixedEdgeDistance distance(base.get(), 0, count - 1, -1000.0 * span * this->candidates);
+
+  TSP tsp(&distance, count);
+  tsp.use_candidates = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_or_opt = this->use_or_opt;
+  tsp.use_lin_kernighan = this->use_lin_kernighan;
+  tsp.buildCandidateLists(data, this->candidates);
+  std::vector<long> order(count);
+  std::iota(order.begin(), order.end(), 0L);
+  tsp.setPath(order.data());
+  double before = tsp.getPathCost();
+  tsp.iteratedLocalSearch(nullptr, "");
+  if (tsp.getPathCost() >= before)
+    return false;
+
+  // Back to a path from city 0 to city count - 1.
+  const long* path = tsp.getPath();
+  long start = std::find(path, path + count, 0L) - path;
+  bool forward = path[(start + count - 1) % count] == count - 1;
+  std::vector<long> result(count);
+  for (long step = 0; step < count; step++)
+    result[step] = cities[path[(start + (forward ? step : count - step)) % count]];
+  cities.swap(result);
+  return true;
+}
+
+// Re-optimizes one window per part of the stitched tour in parallel,
+// centred either on the seam after part p (where it ends and the next part
+// begins, the last seam wrapping to the first part) or on the middle of
+// part p. A window reaches up to part_size / 2 cities to each side, but
+// never past the middle of a part (around seams) or its seams (around
+// middles), so the windows of one pass do not overlap whatever the part
+// sizes. The middle pass frees the cities the seam pass kept fixed.
+void Decomposition::improveWindows(bool around_seams) {
+  long m = parts.size();
+  if (m < 2)
+    return;
+  long half = std::max(4L, this->part_size / 2);
+  long start = 0;
+  for (long p = 0; p < m; p++) {
+    long count_p = parts[p].size(), count_next = parts[(p + 1) % m].size();
+    long centre, before, after;
+    if (around_seams) {
+      centre = start + count_p;
+      before = std::min(half, count_p - count_p / 2);
+      after = std::min(half, count_next / 2);
+    }
+    else {
+      centre = start + count_p / 2;
+      before = std::min(half, count_p / 2);
+      after = std::min(half, count_p - count_p / 2);
+    }
+    start += count_p;
+    long begin = centre - before, count = before + after;
+    if (count < 8)
+      continue;
+    pool->submit([this, begin, count](long) {
+      std::vector<long> cities(count);
+      for (long i = 0; i < count; i++)
+        cities[i] = path[(begin + i) % size];
+      if (!solveWindow(cities))
+        return;
+      for (long i = 0; i < count; i++)
+        path[(begin + i) % size] = cities[i];
+    });
+  }
+  pool->wait();
+}
+
+// Cities with one of their nearest cities in another part.
+void Decomposition::findBoundary() {
+  part_of.assign(size, 0);
+  for (long p = 0; p < (long)parts.size(); p++)
+    for (long city : parts[p])
+      part_of[city] = p;
+
+  KDTree tree(reader->data);
+  long k = std::max(1L, std::min(this->candidates, size - 1));
+  std::vector<char> marked(size, 0);
+  pool->parallelFor(0, size, 4096, [&](long, long lo, long hi) {
+    std::vector<long> near(k);
+    for (long city = lo; city < hi; city++) {
+      long found = tree.nearest(city, k, near.data());
+      for (long n = 0; n < found; n++)
+        if (part_of[near[n]] != part_of[city]) {
+          marked[city] = 1;
+          break;
+        }
+    }
+  });
+
+  boundary.clear();
+  for (long city = 0; city < size; city++)
+    if (marked[city])
+      boundary.push_back(city);
+}
+
+void Decomposition::run() {
+  if (size < 8)
+    return;
+  if (!pool)
+    pool.reset(new ThreadPool(threads));
+
+  splitKDTree();
+  if (this->partition == Partition::KMeans)
+    refineKMeans();
+  orderParts();
+
+  // Largest parts first, so the pool does not end on a big one.
+  long m = parts.size();
+  std::vector<long> order(m);
+  std::iota(order.begin(), order.end(), 0L);
+  std::sort(order.begin(), order.end(),
+            [this](long a, long b) { return parts[a].size() > parts[b].size(); });
+  std::vector<std::vector<long>> tours(m);
+  for (long p : order)
+    pool->submit([this, p, &tours](long) { tours[p] = solvePart(p); });
+  pool->wait();
+
+  stitch(tours);
+  improveWindows(true);
+  improveWindows(false);
+  findBoundary();
+
+  std::unique_ptr<DistanceProvider> distance;
+  if (reader->dist_matrix != nullptr)
+    distance.reset(new MatrixDistance(reader->dist_matrix));
+  else
+    distance.reset(makeDistance(reader->data, reader->edge_weight_type));
+  TSP tsp(distance.get(), size);
+  tsp.random = Random(this->seed);
+  tsp.use_candidates = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_or_opt = this->use_or_opt;
+  tsp.use_lin_kernighan = this->use_lin_kernighan;
+  tsp.buildCandidateLists(reader->data, this->candidates);
+  tsp.setPath(path.data());
+  tsp.localSearchAround(boundary);
+  if (this->boundary_kicks != 0 && !boundary.empty()) {
+    tsp.kick_cities = boundary;
+    tsp.iteratedKickSearch(nullptr, "", this->boundary_kicks, this->boundary_seconds);
+  }
+
+  std::copy(tsp.getPath(), tsp.getPath() + size, path.begin());
+  path_cost = tsp.getPathCost();
+}
+
+void Decomposition::savePath(std::string file_name) {
+  reader->SavePath(file_name, path.data(), path_cost, size);
+}
@@ -0,0 +1,77 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_DECOMPOSITION_H_
+#define INCLUDE_DECOMPOSITION_H_
+#include <memory>
+#include <string>
+#include <vector>
+#include "TSPAlgorithm.h"
+
+class ThreadPool;
+
+// Solver for instances too large for one search: the cities are split into
+// parts of about part_size cities (median k-d splits, optionally refined by
+// k-means), every part is solved on its own TSP with its own matrix-free
+// distances and candidate lists on a pool worker, and the part tours are
+// joined in the order of a tour over the part centroids (each part cut
+// where entering and leaving it costs least). The seams are then improved
+// in two passes: a window of up to part_size tour cities centred on every
+// seam between consecutive parts is re-optimized in parallel with its
+// ends fixed, and a don't-look-bit search over the
+// whole tour is seeded with the boundary cities (those with a near city in
+// another part), optionally followed by kicks at boundary cities. Memory is
+// O(n * candidates); no n x n matrix is built unless the reader has one.
+class Decomposition {
+public:
+  enum class Partition { KDTree, KMeans };
+
+  Partition partition = Partition::KDTree;
+  long part_size = 1000;
+  long kmeans_iterations = 10;
+  long candidates = 8;
+  bool use_or_opt = true;
+  bool use_lin_kernighan = false;
+  // Kicks per part after its descent (0 = descent only).
+  long part_kicks = 0;
+  // Kicks at boundary cities after the seam search, and their time limit
+  // (-1 = no limit).
+  long boundary_kicks = 0;
+  double boundary_seconds = -1;
+  // 0 = one worker per hardware thread.
+  long threads = 0;
+  // Part p kicks with stream p + 1 of this seed, the boundary kicks with
+  // stream 0.
+  unsigned long long seed = 1;
+
+  explicit Decomposition(DataReader* reader);
+  ~Decomposition();
+  Decomposition(const Decomposition&) = delete;
+  Decomposition& operator=(const Decomposition&) = delete;
+
+  void run();
+  const std::vector<long>& getPath() const { return path; }
+  double getPathCost() const { return path_cost; }
+  long getPartCount() const { return (long)parts.size(); }
+  long getBoundaryCount() const { return (long)boundary.size(); }
+  void savePath(std::string file_name);
+
+private:
+  DataReader* reader;
+  long size;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<std::vector<long>> parts;
+  std::vector<long> part_of;
+  std::vector<long> boundary;
+  std::vector<long> path;
+  double path_cost = 0.0;
+
+  void splitKDTree();
+  void refineKMeans();
+  void orderParts();
+  std::vector<long> solvePart(long p) const;
+  void stitch(const std::vector<std::vector<long>>& tours);
+  bool solveWindow(std::vector<long>& cities) const;
+  void improveWindows(bool around_seams);
+  void findBoundary();
+};
+
+#endif  // INCLUDE_DECOMPOSITION_H_
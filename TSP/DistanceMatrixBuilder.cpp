@@ -0,0 +1,122 @@
+// Copyright 2020 GHA Test Team
+#include "DistanceMatrixBuilder.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define DISTANCE_BUILDER_X86
+#endif
+
+namespace {
+
+const long kTile = 64;
+
+// Computes row i for the columns [lo, hi) into len[] and pseudo_len[]
+// (pseudo_len may be nullptr).
+void rowScalar(const double* xs, const double* ys, long i, long lo, long hi,
+               double* len, double* pseudo_len) {
+  for (long j = lo; j < hi; j++) {
+    double dx = xs[j] - xs[i], dy = ys[j] - ys[i];
+    double square = dx * dx + dy * dy;
+    len[j] = std::sqrt(square);
+    if (pseudo_len != nullptr)
+      pseudo_len[j] = std::sqrt(square / 10.0);
+  }
+}
+
+#ifdef DISTANCE_BUILDER_X86
+void rowSSE2(const double* xs, const double* ys, long i, long lo, long hi,
+             double* len, double* pseudo_len) {
+  __m128d xi = _mm_set1_pd(xs[i]), yi = _mm_set1_pd(ys[i]), ten = _mm_set1_pd(10.0);
+  long j = lo;
+  for (; j + 2 <= hi; j += 2) {
+    __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + j), xi);
+    __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + j), yi);
+    __m128d square = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+    _mm_storeu_pd(len + j, _mm_sqrt_pd(square));
+    if (pseudo_len != nullptr)
+      _mm_storeu_pd(pseudo_len + j, _mm_sqrt_pd(_mm_div_pd(square, ten)));
+  }
+  rowScalar(xs, ys, i, j, hi, len, pseudo_len);
+}
+
+#if defined(__GNUC__)
+__attribute__((target("avx")))
+void rowAVX(const double* xs, const double* ys, long i, long lo, long hi,
+            double* len, double* pseudo_len) {
+  __m256d xi = _mm256_set1_pd(xs[i]), yi = _mm256_set1_pd(ys[i]), ten = _mm256_set1_pd(10.0);
+  long j = lo;
+  for (; j + 4 <= hi; j += 4) {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + j), xi);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + j), yi);
+    __m256d square = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    _mm256_storeu_pd(len + j, _mm256_sqrt_pd(square));
+    if (pseudo_len != nullptr)
+      _mm256_storeu_pd(pseudo_len + j, _mm256_sqrt_pd(_mm256_div_pd(square, ten)));
+  }
+  rowScalar(xs, ys, i, j, hi, len, pseudo_len);
+}
+#endif
+#endif
+
+typedef void (*RowKernel)(const double*, const double*, long, long, long, double*, double*);
+
+RowKernel selectKernel() {
+#ifdef DISTANCE_BUILDER_X86
+#if defined(__GNUC__)
+  if (__builtin_cpu_supports("avx"))
+    return rowAVX;
+#endif
+  return rowSSE2;
+#else
+  return rowScalar;
+#endif
+}
+
+}  // namespace
+
+void buildDistanceMatrices(const std::vector<node_info>& data, EdgeWeightType type,
+                           double** dist, double** pseudo, long threads) {
+  long n = data.size();
+  std::vector<double> xs(n), ys(n);
+  for (long i = 0; i < n; i++) {
+    xs[i] = data[i].x;
+    ys[i] = data[i].y;
+  }
+  RowKernel kernel = selectKernel();
+  long tiles = (n + kTile - 1) / kTile;
+
+  // One task per tile row; the tiles on and right of the diagonal are
+  // computed row by row and then mirrored tile by tile.
+  ThreadPool pool(threads);
+  pool.parallelFor(0, tiles, 1, [&](long, long tile_lo, long tile_hi) {
+    for (long ti = tile_lo; ti < tile_hi; ti++) {
+      long i_lo = ti * kTile, i_hi = std::min(n, i_lo + kTile);
+      for (long tj = ti; tj < tiles; tj++) {
+        long j_lo = tj * kTile, j_hi = std::min(n, j_lo + kTile);
+        for (long i = i_lo; i < i_hi; i++) {
+          long lo = std::max(i, j_lo);
+          if (type == EdgeWeightType::RAW) {
+            kernel(xs.data(), ys.data(), i, lo, j_hi, dist[i], pseudo != nullptr ? pseudo[i] : nullptr);
+            continue;
+          }
+          for (long j = lo; j < j_hi; j++) {
+            dist[i][j] = edgeWeight(data[i], data[j], type);
+            if (pseudo != nullptr) {
+              double dx = xs[j] - xs[i], dy = ys[j] - ys[i];
+              pseudo[i][j] = std::sqrt((dx * dx + dy * dy) / 10.0);
+            }
+          }
+        }
+        for (long j = j_lo; j < j_hi; j++) {
+          for (long i = i_lo; i < std::min(i_hi, j); i++) {
+            dist[j][i] = dist[i][j];
+            if (pseudo != nullptr)
+              pseudo[j][i] = pseudo[i][j];
+          }
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,16 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_DISTANCEMATRIXBUILDER_H_
+#define INCLUDE_DISTANCEMATRIXBUILDER_H_
+#include <vector>
+#include "DistanceProvider.h"
+
+// Fills the symmetric n x n matrices dist and pseudo (pseudo may be
+// nullptr) for the given cities. The upper triangle is computed in square
+// tiles spread over `threads` workers (0 = all cores) and mirrored into the
+// lower one. RAW distances use SIMD square roots over structure-of-arrays
+// coordinates; the results are bit-identical to the scalar formula
+// sqrt(dx * dx + dy * dy) and sqrt((dx * dx + dy * dy) / 10.0).
+void buildDistanceMatrices(const std::vector<node_info>& data, EdgeWeightType type,
+                           double** dist, double** pseudo, long threads = 0);
+
+#endif  // INCLUDE_DISTANCEMATRIXBUILDER_H_
@@ -0,0 +1,212 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_DISTANCEPROVIDER_H_
+#define INCLUDE_DISTANCEPROVIDER_H_
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <new>
+
+struct node_info {
+  long id;
+  double x;
+  double y;
+};
+
+
+// TSPLIB EDGE_WEIGHT_TYPE. RAW is the unrounded Euclidean distance used
+// for the bare "id x y" inputs.
+enum class EdgeWeightType { RAW, EUC_2D, CEIL_2D, GEO, ATT };
+
+inline double geoRadians(double coordinate) {
+  const double kPi = 3.141592;
+  double degrees = (long)coordinate;
+  return kPi * (degrees + 5.0 * (coordinate - degrees) / 3.0) / 180.0;
+}
+
+// Distance between two cities as defined by TSPLIB for the given type.
+inline double edgeWeight(const node_info& a, const node_info& b, EdgeWeightType type) {
+  double dx = b.x - a.x, dy = b.y - a.y;
+  switch (type) {
+  case EdgeWeightType::EUC_2D:
+    return (long)(std::sqrt(dx * dx + dy * dy) + 0.5);
+  case EdgeWeightType::CEIL_2D:
+    return std::ceil(std::sqrt(dx * dx + dy * dy));
+  case EdgeWeightType::ATT: {
+    double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+    double t = (long)(r + 0.5);
+    return t < r ? t + 1.0 : t;
+  }
+  case EdgeWeightType::GEO: {
+    const double kEarthRadius = 6378.388;
+    double lat_a = geoRadians(a.x), lon_a = geoRadians(a.y);
+    double lat_b = geoRadians(b.x), lon_b = geoRadians(b.y);
+    double q1 = std::cos(lon_a - lon_b);
+    double q2 = std::cos(lat_a - lat_b);
+    double q3 = std::cos(lat_a + lat_b);
+    return (long)(kEarthRadius * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+  }
+  default:
+    return std::sqrt(dx * dx + dy * dy);
+  }
+}
+
+
+// Compile-time metric a provider is built on (see Metric.h); Generic
+// providers are only reachable through distance().
+enum class MetricKind { Generic, Matrix, Euclidean, PseudoEuclidean, Euc2D, Ceil2D, Att, Geo };
+
+// Source of city-to-city distances for the TSP engine, so that an instance
+// does not have to be held as a dense n x n matrix.
+class DistanceProvider {
+public:
+  virtual ~DistanceProvider() {}
+  virtual double distance(long a, long b) const = 0;
+  virtual MetricKind getKind() const { return MetricKind::Generic; }
+};
+
+
+// Distances looked up in an existing dense matrix (not owned).
+class MatrixDistance : public DistanceProvider {
+private:
+  double** matrix;
+
+public:
+  MatrixDistance(double** matrix) : matrix(matrix) {}
+  double** getMatrix() const { return matrix; }
+  MetricKind getKind() const override { return MetricKind::Matrix; }
+  double distance(long a, long b) const override { return matrix[a][b]; }
+};
+
+
+// Matrix-free distances computed from the coordinates on demand. Needs
+// O(n) memory and gives the same values as DataReader::dist_matrix. The
+// TSP searches reach it through a virtual call and a branch on the type
+// per edge; the providers of makeDistance (Metric.h) avoid both.
+class CoordinateDistance : public DistanceProvider {
+private:
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<node_info> nodes;
+  EdgeWeightType type;
+
+public:
+  CoordinateDistance(const std::vector<node_info>& data, EdgeWeightType type = EdgeWeightType::RAW)
+    : type(type) {
+    if (type != EdgeWeightType::RAW) {
+      nodes = data;
+      return;
+    }
+    xs.reserve(data.size());
+    ys.reserve(data.size());
+    for (const node_info& node : data) {
+      xs.push_back(node.x);
+      ys.push_back(node.y);
+    }
+  }
+
+  double distance(long a, long b) const override {
+    if (type != EdgeWeightType::RAW)
+      return edgeWeight(nodes[a], nodes[b], type);
+    double dx = xs[b] - xs[a], dy = ys[b] - ys[a];
+    return std::sqrt(dx * dx + dy * dy);
+  }
+};
+
+
+// Direct-mapped cache of 2^bits recently used pairs in front of another
+// provider. Lookups write to the cache, so one instance must not be shared
+// between threads.
+class CachedDistance : public DistanceProvider {
+private:
+  struct Entry {
+    long a, b;
+    double value;
+  };
+  const DistanceProvider* source;
+  mutable std::vector<Entry> entries;
+  unsigned long mask;
+
+public:
+  CachedDistance(const DistanceProvider* source, int bits = 16)
+    : source(source), entries(1UL << bits, Entry{ -1, -1, 0.0 }), mask((1UL << bits) - 1) {}
+
+  double distance(long a, long b) const override {
+    if (a > b)
+      std::swap(a, b);
+    unsigned long hash = ((unsigned long)a * 0x9E3779B97F4A7C15UL) ^ (unsigned long)b;
+    Entry& entry = entries[(hash ^ (hash >> 29)) & mask];
+    if (entry.a != a || entry.b != b) {
+      entry.a = a;
+      entry.b = b;
+      entry.value = source->distance(a, b);
+    }
+    return entry.value;
+  }
+};
+
+// Conversion of an exact distance to the element type of PackedDistance:
+// float keeps single precision, int32_t rounds to the nearest integer as
+// TSPLIB does for EUC_2D.
+template <class T>
+inline T packDistance(double length) { return (T)length; }
+
+template <>
+inline int32_t packDistance<int32_t>(double length) { return (int32_t)(length + 0.5); }
+
+
+// Distances precomputed into one contiguous, cache-line aligned block of T.
+// With triangular only the upper triangle (diagonal included) is stored,
+// which halves the memory of a symmetric instance.
+template <class T>
+class PackedDistance : public DistanceProvider {
+private:
+  static const size_t kAlignment = 64;
+  long size;
+  bool triangular;
+  T* values;
+  // First element of row a minus a, for the triangular layout.
+  std::vector<size_t> row_offset;
+
+  size_t index(long a, long b) const {
+    if (!triangular)
+      return (size_t)a * size + b;
+    if (a > b)
+      std::swap(a, b);
+    return row_offset[a] + b;
+  }
+
+public:
+  PackedDistance(const std::vector<node_info>& data, bool triangular = false,
+                 EdgeWeightType type = EdgeWeightType::RAW)
+    : size(data.size()), triangular(triangular) {
+    size_t count = (size_t)size * size;
+    if (triangular) {
+      count = (size_t)size * (size + 1) / 2;
+      row_offset.resize(size);
+      for (long a = 0; a < size; a++)
+        row_offset[a] = (size_t)a * size - (size_t)a * (a + 1) / 2;
+    }
+    values = static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t(kAlignment)));
+
+    for (long a = 0; a < size; a++) {
+      for (long b = triangular ? a : 0; b < size; b++) {
+        values[index(a, b)] = packDistance<T>(edgeWeight(data[a], data[b], type));
+      }
+    }
+  }
+
+  ~PackedDistance() {
+    ::operator delete[](values, std::align_val_t(kAlignment));
+  }
+
+  PackedDistance(const PackedDistance&) = delete;
+  PackedDistance& operator=(const PackedDistance&) = delete;
+
+  size_t getBytes() const {
+    return (triangular ? (size_t)size * (size + 1) / 2 : (size_t)size * size) * sizeof(T);
+  }
+  double distance(long a, long b) const override { return values[index(a, b)]; }
+};
+
+#endif  // INCLUDE_DISTANCEPROVIDER_H_
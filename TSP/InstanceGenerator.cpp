@@ -0,0 +1,46 @@
+// Copyright 2020 GHA Test Team
+#include "InstanceGenerator.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+
+// Only Random and explicit transforms are used, not the <random>
+// distributions, whose output differs between standard libraries: a seed
+// gives the same instance with every compiler.
+
+std::vector<node_info> generateUniform(long n, unsigned long long seed, double side) {
+  Random rng(seed);
+  std::vector<node_info> data(n);
+  for (long i = 0; i < n; i++) {
+    data[i].id = i + 1;
+    data[i].x = rng.uniform() * side;
+    data[i].y = rng.uniform() * side;
+  }
+  return data;
+}
+
+std::vector<node_info> generateClustered(long n, long clusters, unsigned long long seed, double side) {
+  Random rng(seed);
+  clusters = std::max(1L, std::min(clusters, n));
+  std::vector<double> cx(clusters), cy(clusters);
+  for (long c = 0; c < clusters; c++) {
+    cx[c] = rng.uniform() * side;
+    cy[c] = rng.uniform() * side;
+  }
+
+  // Clouds of neighbouring centres overlap only a little on average.
+  const double pi = 3.14159265358979323846;
+  double sigma = side / (4.0 * std::sqrt((double)clusters));
+  std::vector<node_info> data(n);
+  for (long i = 0; i < n; i++) {
+    long c = rng.below(clusters);
+    // Box-Muller: two independent normal offsets from two uniforms, the
+    // first taken in (0, 1] so that its log is finite.
+    double radius = sigma * std::sqrt(-2.0 * std::log(1.0 - rng.uniform()));
+    double angle = 2.0 * pi * rng.uniform();
+    data[i].id = i + 1;
+    data[i].x = std::min(side, std::max(0.0, cx[c] + radius * std::cos(angle)));
+    data[i].y = std::min(side, std::max(0.0, cy[c] + radius * std::sin(angle)));
+  }
+  return data;
+}
@@ -0,0 +1,17 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_INSTANCEGENERATOR_H_
+#define INCLUDE_INSTANCEGENERATOR_H_
+#include <vector>
+#include "DistanceProvider.h"
+
+// Random instances for benchmarking. The same seed always gives the same
+// cities, ids run from 1 like in the TSPLIB files.
+
+// n cities uniform in the side x side square.
+std::vector<node_info> generateUniform(long n, unsigned long long seed, double side = 1000000.0);
+// n cities in `clusters` normal clouds around uniform centres in the
+// side x side square (points outside the square are clamped to it).
+std::vector<node_info> generateClustered(long n, long clusters, unsigned long long seed,
+                                         double side = 1000000.0);
+
+#endif  // INCLUDE_INSTANCEGENERATOR_H_
@@ -0,0 +1,178 @@
+// Copyright 2020 GHA Test Team
+#include "Instrumentation.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace metrics {
+
+#ifdef TSP_INSTRUMENTATION
+// Slots outlive their threads so that the counts of finished workers stay
+// in the totals.
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<Slot>>& registry() {
+  static std::vector<std::unique_ptr<Slot>> slots;
+  return slots;
+}
+
+Slot* registerSlot() {
+  Slot* slot = new Slot();
+  for (auto& value : slot->counters)
+    value.store(0);
+  for (long p = 0; p < (long)Phase::Count; p++) {
+    slot->phase_nanos[p].store(0);
+    slot->phase_calls[p].store(0);
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry().emplace_back(slot);
+  return slot;
+}
+#endif
+
+bool enabled() {
+#ifdef TSP_INSTRUMENTATION
+  return true;
+#else
+  return false;
+#endif
+}
+
+MetricsSnapshot snapshot() {
+  MetricsSnapshot total;
+#ifdef TSP_INSTRUMENTATION
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const auto& slot : registry()) {
+    for (long c = 0; c < (long)Counter::Count; c++)
+      total.counters[c] += slot->counters[c].load(std::memory_order_relaxed);
+    for (long p = 0; p < (long)Phase::Count; p++) {
+      total.phase_nanos[p] += slot->phase_nanos[p].load(std::memory_order_relaxed);
+      total.phase_calls[p] += slot->phase_calls[p].load(std::memory_order_relaxed);
+    }
+  }
+#endif
+  return total;
+}
+
+void reset() {
+#ifdef TSP_INSTRUMENTATION
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const auto& slot : registry()) {
+    for (auto& value : slot->counters)
+      value.store(0, std::memory_order_relaxed);
+    for (long p = 0; p < (long)Phase::Count; p++) {
+      slot->phase_nanos[p].store(0, std::memory_order_relaxed);
+      slot->phase_calls[p].store(0, std::memory_order_relaxed);
+    }
+  }
+#endif
+}
+
+const char* counterName(Counter counter) {
+  switch (counter) {
+  case Counter::MovesEvaluated: return "moves_evaluated";
+  case Counter::MovesAccepted: return "moves_accepted";
+  case Counter::Reversals: return "reversals";
+  case Counter::ReversalLength: return "reversal_length";
+  case Counter::CheckpointBytes: return "checkpoint_bytes";
+  default: return "unknown";
+  }
+}
+
+const char* phaseName(Phase phase) {
+  switch (phase) {
+  case Phase::Construction: return "construction";
+  case Phase::LocalSearch: return "local_search";
+  case Phase::Kick: return "kick";
+  case Phase::Io: return "io";
+  case Phase::Checkpoint: return "checkpoint";
+  default: return "unknown";
+  }
+}
+
+std::string toJson(const MetricsSnapshot& snapshot) {
+  std::ostringstream out;
+  out.precision(9);
+  out << "{\"enabled\": " << (enabled() ? "true" : "false") << ", \"counters\": {";
+  for (long c = 0; c < (long)Counter::Count; c++)
+    out << (c ? ", " : "") << "\"" << counterName((Counter)c) << "\": " << snapshot.counters[c];
+  out << "}, \"phases\": {";
+  for (long p = 0; p < (long)Phase::Count; p++) {
+    out << (p ? ", " : "") << "\"" << phaseName((Phase)p) << "\": {\"seconds\": "
+        << snapshot.phase_nanos[p] * 1e-9 << ", \"calls\": " << snapshot.phase_calls[p] << "}";
+  }
+  out << "}}\n";
+  return out.str();
+}
+
+std::string toPrometheus(const MetricsSnapshot& snapshot) {
+  std::ostringstream out;
+  out.precision(9);
+  for (long c = 0; c < (long)Counter::Count; c++) {
+    std::string name = std::string("tsp_") + counterName((Counter)c) + "_total";
+    out << "# TYPE " << name << " counter\n" << name << " " << snapshot.counters[c] << "\n";
+  }
+  out << "# TYPE tsp_phase_seconds_total counter\n";
+  for (long p = 0; p < (long)Phase::Count; p++)
+    out << "tsp_phase_seconds_total{phase=\"" << phaseName((Phase)p) << "\"} "
+        << snapshot.phase_nanos[p] * 1e-9 << "\n";
+  out << "# TYPE tsp_phase_calls_total counter\n";
+  for (long p = 0; p < (long)Phase::Count; p++)
+    out << "tsp_phase_calls_total{phase=\"" << phaseName((Phase)p) << "\"} "
+        << snapshot.phase_calls[p] << "\n";
+  return out.str();
+}
+
+}  // namespace metrics
+
+
+MetricsExporter::MetricsExporter(const std::string& file_name, Format format, double interval_seconds)
+  : file_name(file_name), format(format),
+    interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(interval_seconds))) {
+  worker = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  worker.join();
+  dump();
+}
+
+bool MetricsExporter::dump() {
+  MetricsSnapshot snapshot = metrics::snapshot();
+  std::string text = format == Format::Json ? metrics::toJson(snapshot) : metrics::toPrometheus(snapshot);
+  std::lock_guard<std::mutex> lock(dump_mutex);
+  std::string temp_name = file_name + ".tmp";
+  bool written;
+  {
+    std::ofstream out(temp_name);
+    written = out.is_open() && (out << text).good();
+  }
+  // As in CheckpointWriter::write: rename replaces the file atomically on
+  // POSIX, the old file is removed only when that fails (Windows).
+  if (written && std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+    std::remove(file_name.c_str());
+    written = std::rename(temp_name.c_str(), file_name.c_str()) == 0;
+  }
+  if (!written)
+    std::cerr << "MetricsExporter: cannot write " << file_name << std::endl;
+  return written;
+}
+
+void MetricsExporter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (wake.wait_for(lock, interval, [this] { return stopping; }))
+      break;
+    lock.unlock();
+    dump();
+    lock.lock();
+  }
+}
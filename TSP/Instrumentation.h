@@ -0,0 +1,121 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_INSTRUMENTATION_H_
+#define INCLUDE_INSTRUMENTATION_H_
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Counters and phase timers for the search. They are compiled in only with
+// -DTSP_INSTRUMENTATION; otherwise TSP_COUNT and TSP_PHASE expand to
+// nothing and snapshots read zero. Every thread counts into its own slot
+// and a snapshot sums the slots of all threads that ever counted. Phase
+// times are inclusive, a phase entered from another one counts in both.
+
+enum class Counter { MovesEvaluated, MovesAccepted, Reversals, ReversalLength, CheckpointBytes, Count };
+enum class Phase { Construction, LocalSearch, Kick, Io, Checkpoint, Count };
+
+struct MetricsSnapshot {
+  long long counters[(int)Counter::Count] = {};
+  long long phase_nanos[(int)Phase::Count] = {};
+  long long phase_calls[(int)Phase::Count] = {};
+};
+
+namespace metrics {
+
+bool enabled();
+MetricsSnapshot snapshot();
+// Zeroes every slot; counts racing with the reset may be lost.
+void reset();
+const char* counterName(Counter counter);
+const char* phaseName(Phase phase);
+std::string toJson(const MetricsSnapshot& snapshot);
+std::string toPrometheus(const MetricsSnapshot& snapshot);
+
+#ifdef TSP_INSTRUMENTATION
+// Written only by its thread, so a relaxed load and store is enough.
+struct Slot {
+  std::atomic<long long> counters[(int)Counter::Count];
+  std::atomic<long long> phase_nanos[(int)Phase::Count];
+  std::atomic<long long> phase_calls[(int)Phase::Count];
+};
+
+Slot* registerSlot();
+
+inline Slot& threadSlot() {
+  thread_local Slot* slot = nullptr;
+  if (slot == nullptr)
+    slot = registerSlot();
+  return *slot;
+}
+
+inline void bump(std::atomic<long long>& value, long long n) {
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void add(Counter counter, long long n) {
+  bump(threadSlot().counters[(int)counter], n);
+}
+
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+  ~PhaseTimer() {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    Slot& slot = threadSlot();
+    bump(slot.phase_nanos[(int)phase], elapsed.count());
+    bump(slot.phase_calls[(int)phase], 1);
+  }
+
+private:
+  Phase phase;
+  std::chrono::steady_clock::time_point start;
+};
+#endif
+
+}  // namespace metrics
+
+#ifdef TSP_INSTRUMENTATION
+#define TSP_METRICS_JOIN2(a, b) a##b
+#define TSP_METRICS_JOIN(a, b) TSP_METRICS_JOIN2(a, b)
+#define TSP_COUNT(counter, n) metrics::add(Counter::counter, (n))
+#define TSP_PHASE(phase) metrics::PhaseTimer TSP_METRICS_JOIN(phase_timer_, __LINE__)(Phase::phase)
+#else
+#define TSP_COUNT(counter, n) ((void)0)
+#define TSP_PHASE(phase) ((void)0)
+#endif
+
+
+// Rewrites file_name with a snapshot every interval from a background
+// thread (through a temporary file and a rename, so a scraper never reads
+// a partial dump), and once more on destruction.
+class MetricsExporter {
+public:
+  enum class Format { Json, Prometheus };
+
+  MetricsExporter(const std::string& file_name, Format format = Format::Json,
+                  double interval_seconds = 10.0);
+  ~MetricsExporter();
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // Returns false (and reports on std::cerr) when the file could not be
+  // written; the previous dump, if any, is then left in place.
+  bool dump();
+
+private:
+  std::string file_name;
+  Format format;
+  std::chrono::steady_clock::duration interval;
+  std::mutex mutex;
+  std::mutex dump_mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::thread worker;
+
+  void run();
+};
+
+#endif  // INCLUDE_INSTRUMENTATION_H_
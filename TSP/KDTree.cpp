@@ -0,0 +1,172 @@
+// Copyright 2020 GHA Test Team
+#include "KDTree.h"
+#include <algorithm>
+#include <limits>
+
+
+KDTree::KDTree(const std::vector<node_info>& data) {
+  long n = data.size();
+  xs.resize(n);
+  ys.resize(n);
+  index.resize(n);
+  for (long i = 0; i < n; i++) {
+    xs[i] = data[i].x;
+    ys[i] = data[i].y;
+    index[i] = i;
+  }
+  build(0, n, 0);
+  slot.resize(n);
+  for (long i = 0; i < n; i++)
+    slot[index[i]] = i;
+}
+
+void KDTree::build(long lo, long hi, int depth) {
+  if (hi - lo <= kLeafSize)
+    return;
+
+  long m = (lo + hi) / 2;
+  const std::vector<double>& axis = (depth & 1) ? ys : xs;
+  std::nth_element(index.begin() + lo, index.begin() + m, index.begin() + hi,
+                   [&axis](long a, long b) { return axis[a] < axis[b]; });
+  build(lo, m, depth + 1);
+  build(m + 1, hi, depth + 1);
+}
+
+void KDTree::search(long lo, long hi, int depth, double x, double y, long self, long k,
+                    std::vector<std::pair<double, long>>& heap) const {
+  auto consider = [&](long city) {
+    if (city == self)
+      return;
+    double dx = xs[city] - x, dy = ys[city] - y;
+    double dist = dx * dx + dy * dy;
+    if ((long)heap.size() < k) {
+      heap.push_back(std::make_pair(dist, city));
+      std::push_heap(heap.begin(), heap.end());
+    }
+    else if (dist < heap.front().first) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = std::make_pair(dist, city);
+      std::push_heap(heap.begin(), heap.end());
+    }
+  };
+
+  if (hi - lo <= kLeafSize) {
+    for (long i = lo; i < hi; i++)
+      consider(index[i]);
+    return;
+  }
+
+  long m = (lo + hi) / 2;
+  long city = index[m];
+  double diff = (depth & 1) ? y - ys[city] : x - xs[city];
+  consider(city);
+
+  if (diff < 0) {
+    search(lo, m, depth + 1, x, y, self, k, heap);
+    if ((long)heap.size() < k || diff * diff < heap.front().first)
+      search(m + 1, hi, depth + 1, x, y, self, k, heap);
+  }
+  else {
+    search(m + 1, hi, depth + 1, x, y, self, k, heap);
+    if ((long)heap.size() < k || diff * diff < heap.front().first)
+      search(lo, m, depth + 1, x, y, self, k, heap);
+  }
+}
+
+long KDTree::nearest(long city, long k, long* out) const {
+  std::vector<std::pair<double, long>> heap;
+  heap.reserve(k + 1);
+  search(0, getSize(), 0, xs[city], ys[city], city, k, heap);
+  std::sort_heap(heap.begin(), heap.end());
+  for (size_t i = 0; i < heap.size(); i++)
+    out[i] = heap[i].second;
+  return heap.size();
+}
+
+// The count of a range [lo, hi) lives at its midpoint, which no other
+// range of the tree shares.
+UnvisitedCities::UnvisitedCities(const KDTree& tree) : tree(tree) {
+  left.resize(tree.getSize());
+  taken.resize(tree.getSize());
+  reset();
+}
+
+void UnvisitedCities::reset() {
+  std::fill(taken.begin(), taken.end(), 0);
+  count(0, tree.getSize());
+}
+
+long UnvisitedCities::count(long lo, long hi) {
+  if (lo >= hi)
+    return 0;
+  long m = (lo + hi) / 2;
+  if (hi - lo > KDTree::kLeafSize) {
+    count(lo, m);
+    count(m + 1, hi);
+  }
+  return left[m] = hi - lo;
+}
+
+void UnvisitedCities::remove(long city) {
+  if (taken[city])
+    return;
+  taken[city] = 1;
+
+  long pos = tree.slot[city], lo = 0, hi = tree.getSize();
+  while (true) {
+    long m = (lo + hi) / 2;
+    left[m]--;
+    if (hi - lo <= KDTree::kLeafSize || pos == m)
+      return;
+    if (pos < m)
+      hi = m;
+    else
+      lo = m + 1;
+  }
+}
+
+void UnvisitedCities::search(long lo, long hi, int depth, double x, double y,
+                             double& best_dist, long& best) const {
+  if (lo >= hi || left[(lo + hi) / 2] == 0)
+    return;
+
+  auto consider = [&](long city) {
+    if (taken[city])
+      return;
+    double dx = tree.xs[city] - x, dy = tree.ys[city] - y;
+    double dist = dx * dx + dy * dy;
+    if (dist < best_dist) {
+      best_dist = dist;
+      best = city;
+    }
+  };
+
+  if (hi - lo <= KDTree::kLeafSize) {
+    for (long i = lo; i < hi; i++)
+      consider(tree.index[i]);
+    return;
+  }
+
+  long m = (lo + hi) / 2;
+  long city = tree.index[m];
+  double diff = (depth & 1) ? y - tree.ys[city] : x - tree.xs[city];
+  consider(city);
+
+  if (diff < 0) {
+    search(lo, m, depth + 1, x, y, best_dist, best);
+    if (diff * diff < best_dist)
+      search(m + 1, hi, depth + 1, x, y, best_dist, best);
+  }
+  else {
+    search(m + 1, hi, depth + 1, x, y, best_dist, best);
+    if (diff * diff < best_dist)
+      search(lo, m, depth + 1, x, y, best_dist, best);
+  }
+}
+
+long UnvisitedCities::nearest(long city) const {
+  double best_dist = std::numeric_limits<double>::infinity();
+  long best = -1;
+  search(0, tree.getSize(), 0, tree.xs[city], tree.ys[city], best_dist, best);
+  return best;
+}
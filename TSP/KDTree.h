@@ -0,0 +1,57 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_KDTREE_H_
+#define INCLUDE_KDTREE_H_
+#include <vector>
+#include "DistanceProvider.h"
+
+// Static 2-d tree over the city coordinates. The tree is stored implicitly
+// in the index array: every range [lo, hi) is split at its median.
+class KDTree {
+private:
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<long> index;
+  std::vector<long> slot;
+  static const long kLeafSize = 8;
+
+  void build(long lo, long hi, int depth);
+  void search(long lo, long hi, int depth, double x, double y, long self, long k,
+              std::vector<std::pair<double, long>>& heap) const;
+
+public:
+  KDTree(const std::vector<node_info>& data);
+
+  long getSize() const { return (long)index.size(); }
+  // Writes the k nearest cities to `city` (itself excluded) into out,
+  // closest first. Returns the number of cities written.
+  long nearest(long city, long k, long* out) const;
+
+  friend class UnvisitedCities;
+};
+
+// Cities of a KDTree that have not been taken yet, for the constructive
+// heuristics. Every range of the tree keeps the number of cities left in
+// it, so removal is O(log n) and the nearest query skips emptied ranges.
+// The tree can be shared, one set per thread.
+class UnvisitedCities {
+private:
+  const KDTree& tree;
+  std::vector<long> left;
+  std::vector<char> taken;
+
+  long count(long lo, long hi);
+  void search(long lo, long hi, int depth, double x, double y,
+              double& best_dist, long& best) const;
+
+public:
+  explicit UnvisitedCities(const KDTree& tree);
+
+  // Puts every city back.
+  void reset();
+  bool contains(long city) const { return !taken[city]; }
+  void remove(long city);
+  // Closest city still in the set, -1 when it is empty.
+  long nearest(long city) const;
+};
+
+#endif  // INCLUDE_KDTREE_H_
@@ -0,0 +1,170 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_METRIC_H_
+#define INCLUDE_METRIC_H_
+#include <cmath>
+#include <vector>
+#include "DistanceProvider.h"
+
+// Compile-time distance policies. A metric is a small copyable object with
+// double operator()(long a, long b) const; the engine's hot loops are
+// templates over it, so the formula is inlined and no edge pays for a
+// branch on the edge weight type or a virtual call. The runtime type is
+// resolved once, at the API boundary (makeDistance, TSP::withMetric).
+
+// Coordinate formulas. prepare() maps a city's coordinates once when the
+// metric is built, length() is the weight of the edge between two
+// prepared cities. Each one matches edgeWeight for its type.
+struct EuclideanFormula {
+  static const MetricKind kind = MetricKind::Euclidean;
+  static void prepare(double&, double&) {}
+  static double length(double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    return std::sqrt(dx * dx + dy * dy);
+  }
+};
+
+// The former pseudo matrix: Euclidean distance scaled by 1 / sqrt(10).
+struct PseudoEuclideanFormula {
+  static const MetricKind kind = MetricKind::PseudoEuclidean;
+  static void prepare(double&, double&) {}
+  static double length(double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    return std::sqrt((dx * dx + dy * dy) / 10.0);
+  }
+};
+
+struct Euc2DFormula {
+  static const MetricKind kind = MetricKind::Euc2D;
+  static void prepare(double&, double&) {}
+  static double length(double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    return (long)(std::sqrt(dx * dx + dy * dy) + 0.5);
+  }
+};
+
+struct Ceil2DFormula {
+  static const MetricKind kind = MetricKind::Ceil2D;
+  static void prepare(double&, double&) {}
+  static double length(double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    return std::ceil(std::sqrt(dx * dx + dy * dy));
+  }
+};
+
+struct AttFormula {
+  static const MetricKind kind = MetricKind::Att;
+  static void prepare(double&, double&) {}
+  static double length(double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+    double t = (long)(r + 0.5);
+    return t < r ? t + 1.0 : t;
+  }
+};
+
+// Cities are kept as latitude / longitude in radians.
+struct GeoFormula {
+  static const MetricKind kind = MetricKind::Geo;
+  static void prepare(double& x, double& y) {
+    x = geoRadians(x);
+    y = geoRadians(y);
+  }
+  static double length(double lat_a, double lon_a, double lat_b, double lon_b) {
+    const double kEarthRadius = 6378.388;
+    double q1 = std::cos(lon_a - lon_b);
+    double q2 = std::cos(lat_a - lat_b);
+    double q3 = std::cos(lat_a + lat_b);
+    return (long)(kEarthRadius * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+  }
+};
+
+template <class Formula>
+class CoordinateMetric {
+private:
+  std::vector<double> xs;
+  std::vector<double> ys;
+
+public:
+  explicit CoordinateMetric(const std::vector<node_info>& data) {
+    xs.reserve(data.size());
+    ys.reserve(data.size());
+    for (const node_info& node : data) {
+      double x = node.x, y = node.y;
+      Formula::prepare(x, y);
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+
+  double operator()(long a, long b) const {
+    return Formula::length(xs[a], ys[a], xs[b], ys[b]);
+  }
+};
+
+// An explicit n x n matrix (not owned).
+class MatrixMetric {
+private:
+  double** matrix;
+
+public:
+  explicit MatrixMetric(double** matrix) : matrix(matrix) {}
+  double operator()(long a, long b) const { return matrix[a][b]; }
+};
+
+// Any other provider, through its virtual call.
+class ProviderMetric {
+private:
+  const DistanceProvider* provider;
+
+public:
+  explicit ProviderMetric(const DistanceProvider* provider) : provider(provider) {}
+  double operator()(long a, long b) const { return provider->distance(a, b); }
+};
+
+
+// DistanceProvider over a coordinate metric. getKind() tells the engine
+// which policy to instantiate its loops with.
+template <class Formula>
+class MetricDistance : public DistanceProvider {
+private:
+  CoordinateMetric<Formula> metric;
+
+public:
+  explicit MetricDistance(const std::vector<node_info>& data) : metric(data) {}
+  const CoordinateMetric<Formula>& getMetric() const { return metric; }
+  MetricKind getKind() const override { return Formula::kind; }
+  double distance(long a, long b) const override { return metric(a, b); }
+};
+
+// The runtime selector: a matrix-free provider for the TSPLIB type, or the
+// pseudo-Euclidean one. The caller owns the result.
+inline DistanceProvider* makeDistance(const std::vector<node_info>& data, EdgeWeightType type,
+                                      bool pseudo = false) {
+  if (pseudo)
+    return new MetricDistance<PseudoEuclideanFormula>(data);
+  switch (type) {
+  case EdgeWeightType::EUC_2D:
+    return new MetricDistance<Euc2DFormula>(data);
+  case EdgeWeightType::CEIL_2D:
+    return new MetricDistance<Ceil2DFormula>(data);
+  case EdgeWeightType::ATT:
+    return new MetricDistance<AttFormula>(data);
+  case EdgeWeightType::GEO:
+    return new MetricDistance<GeoFormula>(data);
+  default:
+    return new MetricDistance<EuclideanFormula>(data);
+  }
+}
+
+// Length of the closed tour under a metric.
+template <class Metric>
+double tourLength(const Metric& metric, const long* path, long size) {
+  if (size < 2)
+    return 0.0;
+  double cost = 0.0;
+  for (long i = 0; i + 1 < size; i++)
+    cost += metric(path[i], path[i + 1]);
+  return cost + metric(path[size - 1], path[0]);
+}
+
+#endif  // INCLUDE_METRIC_H_
@@ -0,0 +1,80 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_RANDOM_H_
+#define INCLUDE_RANDOM_H_
+
+// xoshiro256** generator. Its state lives in the object, so every thread
+// or worker owns its own generator: no lock and no shared state, unlike
+// std::rand. A (seed, stream) pair always gives the same sequence, and
+// different streams of one master seed are independent (their states are
+// drawn through splitmix64), which keeps parallel runs reproducible no
+// matter how the work is scheduled. Satisfies UniformRandomBitGenerator,
+// so it can drive std::shuffle and the <random> distributions.
+class Random {
+public:
+  typedef unsigned long long result_type;
+
+  explicit Random(unsigned long long seed = 1, unsigned long long stream = 0) {
+    this->seed(seed, stream);
+  }
+
+  void seed(unsigned long long seed, unsigned long long stream = 0) {
+    master = seed;
+    unsigned long long x = seed ^ mix(stream + 0x632BE59BD9B4E019ULL);
+    for (int i = 0; i < 4; i++)
+      s[i] = splitmix(x);
+  }
+
+  // Stream `stream` of the master seed this generator was made from.
+  Random split(unsigned long long stream) const {
+    return Random(master, stream);
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~0ULL; }
+
+  result_type operator()() {
+    result_type result = rotl(s[1] * 5, 7) * 9;
+    result_type t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, n), n > 0. Multiply-shift on 32 bits when n fits,
+  // modulo of 64 bits otherwise; the bias is below 2^-32 either way.
+  unsigned long long below(unsigned long long n) {
+    if (n <= 0xFFFFFFFFULL)
+      return (((*this)() >> 32) * n) >> 32;
+    return (*this)() % n;
+  }
+
+  // Uniform in [0, 1).
+  double uniform() {
+    return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+private:
+  result_type s[4];
+  result_type master;
+
+  static result_type rotl(result_type x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  static result_type mix(result_type z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  static result_type splitmix(result_type& x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    return mix(x);
+  }
+};
+
+#endif  // INCLUDE_RANDOM_H_
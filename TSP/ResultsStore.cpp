@@ -0,0 +1,195 @@
+// Copyright 2020 GHA Test Team
+#include "ResultsStore.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+static const char kRecordMagic[4] = { 'T', 'S', 'P', 'R' };
+static const unsigned long long kRecordHeader = 4 + 5 * 8;
+static const unsigned long long kIndexEntry = 6 * 8;
+
+template <class T>
+static void put(std::ostream& out, T value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+static bool get(std::istream& in, T& value) {
+  return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+static void writeIndexEntry(std::ostream& out, const ResultsStore::Entry& entry) {
+  put<double>(out, entry.cost);
+  put<int64_t>(out, entry.start);
+  put<double>(out, entry.seconds);
+  put<int64_t>(out, entry.timestamp);
+  put<uint64_t>(out, entry.offset);
+  put<int64_t>(out, entry.size);
+}
+
+static bool readIndexEntry(std::istream& in, ResultsStore::Entry& entry) {
+  int64_t start, timestamp, size;
+  uint64_t offset;
+  if (!get(in, entry.cost) || !get(in, start) || !get(in, entry.seconds) ||
+      !get(in, timestamp) || !get(in, offset) || !get(in, size))
+    return false;
+  entry.start = start;
+  entry.timestamp = timestamp;
+  entry.offset = offset;
+  entry.size = size;
+  return true;
+}
+
+// Reads the header of the record at the current position of in.
+static bool readRecordHeader(std::istream& in, unsigned long long offset, ResultsStore::Entry& entry) {
+  char magic[4];
+  int64_t start, timestamp, size;
+  if (!in.read(magic, 4) || std::memcmp(magic, kRecordMagic, 4) != 0)
+    return false;
+  if (!get(in, start) || !get(in, entry.cost) || !get(in, entry.seconds) ||
+      !get(in, timestamp) || !get(in, size) || size < 0)
+    return false;
+  entry.start = start;
+  entry.timestamp = timestamp;
+  entry.offset = offset;
+  entry.size = size;
+  return true;
+}
+
+static unsigned long long fileSize(const std::string& file_name) {
+  std::ifstream in(file_name, std::ios::binary | std::ios::ate);
+  if (!in.is_open())
+    return 0;
+  return (unsigned long long)in.tellg();
+}
+
+ResultsStore::ResultsStore(const std::string& dir_name, const std::string& instance)
+  : results_name(dir_name + instance + ".results"), index_name(dir_name + instance + ".index") {
+  load();
+}
+
+// Reads the index, then recovers the complete records past its last entry
+// from the results file. The index is rewritten when it ends in a partial
+// entry or records had to be recovered, and the results file is cut back
+// to its last complete record, so that new records follow it.
+void ResultsStore::load() {
+  unsigned long long indexed_end = 0;
+  unsigned long long index_size = fileSize(index_name);
+  std::ifstream index_in(index_name, std::ios::binary);
+  Entry entry;
+  while (index_in.is_open() && readIndexEntry(index_in, entry)) {
+    entries.insert(entry);
+    indexed_end = std::max(indexed_end, entry.offset + kRecordHeader + 4 * entry.size);
+  }
+  index_in.close();
+
+  end_offset = fileSize(results_name);
+  bool rewrite = index_size % kIndexEntry != 0;
+  std::ifstream results_in(results_name, std::ios::binary);
+  unsigned long long offset = indexed_end;
+  while (results_in.is_open() && offset + kRecordHeader <= end_offset) {
+    results_in.seekg(offset);
+    if (!readRecordHeader(results_in, offset, entry))
+      break;
+    unsigned long long next = offset + kRecordHeader + 4 * entry.size;
+    if (next > end_offset)
+      break;
+    entries.insert(entry);
+    rewrite = true;
+    offset = next;
+  }
+  results_in.close();
+
+  if (offset < end_offset) {
+    std::error_code error;
+    std::filesystem::resize_file(results_name, offset, error);
+    if (error)
+      std::cerr << "ResultsStore: cannot truncate " << results_name << ": " << error.message() << std::endl;
+    else
+      end_offset = offset;
+  }
+
+  if (rewrite) {
+    std::ofstream out(index_name, std::ios::binary | std::ios::trunc);
+    for (const Entry& saved : entries)
+      writeIndexEntry(out, saved);
+  }
+  results.open(results_name, std::ios::binary | std::ios::app);
+  index.open(index_name, std::ios::binary | std::ios::app);
+}
+
+bool ResultsStore::isOpen() const {
+  return results.is_open() && index.is_open();
+}
+
+void ResultsStore::append(long start, double cost, double seconds, const long* tour, long size) {
+  std::vector<int32_t> cities(tour, tour + size);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!isOpen())
+    return;
+
+  Entry entry;
+  entry.cost = cost;
+  entry.start = start;
+  entry.seconds = seconds;
+  entry.timestamp = (long long)std::time(nullptr);
+  entry.offset = end_offset;
+  entry.size = size;
+
+  results.write(kRecordMagic, 4);
+  put<int64_t>(results, entry.start);
+  put<double>(results, entry.cost);
+  put<double>(results, entry.seconds);
+  put<int64_t>(results, entry.timestamp);
+  put<int64_t>(results, entry.size);
+  results.write(reinterpret_cast<const char*>(cities.data()), cities.size() * sizeof(int32_t));
+  results.flush();
+  end_offset += kRecordHeader + 4 * size;
+
+  // The record is on disk before its index entry, so a crash in between
+  // only loses the entry, which load() recovers.
+  writeIndexEntry(index, entry);
+  index.flush();
+  entries.insert(entry);
+}
+
+long ResultsStore::getCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+bool ResultsStore::best(Entry& entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (entries.empty())
+    return false;
+  entry = *entries.begin();
+  return true;
+}
+
+std::vector<ResultsStore::Entry> ResultsStore::top(long k) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Entry> result;
+  for (auto it = entries.begin(); it != entries.end() && (long)result.size() < k; ++it)
+    result.push_back(*it);
+  return result;
+}
+
+bool ResultsStore::readTour(const Entry& entry, std::vector<long>& tour) const {
+  std::ifstream in(results_name, std::ios::binary);
+  if (!in.is_open())
+    return false;
+  in.seekg(entry.offset);
+  Entry header;
+  if (!readRecordHeader(in, entry.offset, header) || header.size != entry.size)
+    return false;
+
+  std::vector<int32_t> cities(header.size);
+  if (!in.read(reinterpret_cast<char*>(cities.data()), cities.size() * sizeof(int32_t)))
+    return false;
+  tour.assign(cities.begin(), cities.end());
+  return true;
+}
@@ -0,0 +1,62 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_RESULTSSTORE_H_
+#define INCLUDE_RESULTSSTORE_H_
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Append-only store of finished runs for one instance, in two files of
+// dir_name:
+//   <instance>.results  records "TSPR", int64 start, double cost,
+//                       double seconds, int64 unix time, int64 size and
+//                       size int32 city indices;
+//   <instance>.index    one fixed-size entry per record (cost, start,
+//                       seconds, time, offset of the record, size).
+// The index is read back on opening (records missing from it after a
+// crash are recovered from the results file) and kept sorted by cost in
+// memory, so the best run is O(1), the k best O(k) and an append
+// O(log n). The tours themselves are only read on request.
+class ResultsStore {
+public:
+  struct Entry {
+    double cost;
+    long start;
+    double seconds;
+    long long timestamp;
+    unsigned long long offset;
+    long size;
+
+    bool operator<(const Entry& other) const {
+      return cost < other.cost || (cost == other.cost && offset < other.offset);
+    }
+  };
+
+  ResultsStore(const std::string& dir_name, const std::string& instance);
+  ResultsStore(const ResultsStore&) = delete;
+  ResultsStore& operator=(const ResultsStore&) = delete;
+
+  bool isOpen() const;
+  // Safe to call from several search threads.
+  void append(long start, double cost, double seconds, const long* tour, long size);
+  long getCount() const;
+  // False when the store is empty.
+  bool best(Entry& entry) const;
+  // The k cheapest runs, cheapest first.
+  std::vector<Entry> top(long k) const;
+  bool readTour(const Entry& entry, std::vector<long>& tour) const;
+
+private:
+  std::string results_name;
+  std::string index_name;
+  mutable std::mutex mutex;
+  std::ofstream results;
+  std::ofstream index;
+  std::set<Entry> entries;
+  unsigned long long end_offset = 0;
+
+  void load();
+};
+
+#endif  // INCLUDE_RESULTSSTORE_H_
@@ -1,5 +1,22 @@
 #include "TSPAlgorithm.h"
+#include "KDTree.h"
+#include "ThreadPool.h"
+#include "TwoOptKernel.h"
+#include "CheckpointWriter.h"
+#include "ResultsStore.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 
+// Moves must shorten the tour by more than this to be accepted, otherwise
+// rounding noise in the gains can make the search cycle.
+const double kImproveEps = 1e-9;
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
 
 long TSP::getSize() const {
   return this->size;
@@ -17,8 +34,20 @@ double** TSP::getDistMatrix() const {
   return this->dist_matrix;
 }
 
+long long TSP::getMovesEvaluated() const {
+  return this->moves_evaluated;
+}
+
+const DistanceProvider* TSP::getDistance() const {
+  return this->distance;
+}
+
 TSP::~TSP() {
-  delete[] path;
+  if (owns_distance)
+    delete distance;
+  delete[] neighbours;
+  delete pool;
+  delete list;
 }
 
 template <class T>
@@ -31,10 +60,61 @@ void TSP::mirror_matrix(T** matrix, long size_t) {
   }
 }
 
-TSP::TSP(double** dist_matrix, double** dist_pseudo_matrix, long node_num) {
+TSP::TSP(double** dist_matrix, double** dist_pseudo_matrix, long node_num) : workspace(node_num) {
   this->dist_matrix = dist_matrix;
   this->dist_pseudo_matrix = dist_pseudo_matrix;
+  this->distance = new MatrixDistance(dist_matrix);
+  this->owns_distance = true;
+  this->size = node_num;
+  this->path = nullptr;
+}
+
+TSP::TSP(const DistanceProvider* distance, long node_num) : workspace(node_num) {
+  this->dist_matrix = nullptr;
+  this->dist_pseudo_matrix = nullptr;
+  this->distance = distance;
+  this->owns_distance = false;
   this->size = node_num;
+  this->path = nullptr;
+}
+
+TSP::TSP(const TSP& other) : workspace(other.size) {
+  this->size = other.size;
+  this->path_cost = other.path_cost;
+  this->dist_matrix = other.dist_matrix;
+  this->dist_pseudo_matrix = other.dist_pseudo_matrix;
+  this->owns_distance = other.owns_distance;
+  this->distance = other.owns_distance ? new MatrixDistance(other.dist_matrix) : other.distance;
+  this->path = nullptr;
+  if (other.path != nullptr) {
+    this->path = this->workspace.path();
+    std::copy(other.path, other.path + this->size, this->path);
+  }
+  this->neighbours_k = other.neighbours_k;
+  if (other.neighbours != nullptr) {
+    this->neighbours = new long[this->size * this->neighbours_k];
+    std::copy(other.neighbours, other.neighbours + this->size * this->neighbours_k, this->neighbours);
+  }
+
+  this->first_step = other.first_step;
+  this->use_candidates = other.use_candidates;
+  this->use_or_opt = other.use_or_opt;
+  this->use_lin_kernighan = other.use_lin_kernighan;
+  this->lk_max_depth = other.lk_max_depth;
+  this->use_dont_look_bits = other.use_dont_look_bits;
+  this->threads = other.threads;
+  this->use_simd = other.use_simd;
+  this->two_level_min_size = other.two_level_min_size;
+  this->kick = other.kick;
+  this->kick_length = other.kick_length;
+  this->acceptance = other.acceptance;
+  this->accept_threshold = other.accept_threshold;
+  this->kick_cities = other.kick_cities;
+  this->random = other.random;
+  this->checkpoint = other.checkpoint;
+  this->results = other.results;
+  this->city_x = other.city_x;
+  this->city_y = other.city_y;
 }
 
 bool checkInArray(long* array, long size, double el) {
@@ -54,14 +134,14 @@ void TSP::printDecisionPath() {
 void TSP::printMatrixDist() {
   for (long i = 0; i < 25; i++) {
     for (long j = 0; j < 25; j++) {
-      std::cout << dist_matrix[i][j] << " ";
+      std::cout << dist(i, j) << " ";
     }
     std::cout << std::endl;
   }
 }
 
 void TSP::randomNodeStarter(DataReader* reader, std::string file_name, std::string dir_name, long node_start, long node_finish, long iterations) {
-  long* best_path = nullptr;
+  long* best_path = this->workspace.bestStartPath();
   double best_cost = std::numeric_limits<double>::infinity();
 
   std::string file_name_init = file_name;
@@ -78,77 +158,315 @@ void TSP::randomNodeStarter(DataReader* reader, std::string file_name, std::stri
   }
 
 
+  Random master = this->random;
   for (long i = node_start; i < node_finish; i++) {
     file_name = dir_name + std::to_string(i) + file_name_init;
+    auto start = std::chrono::steady_clock::now();
+    this->random = master.split(i);
     this->createInitialDecision(i);
-    this->iteratedLocalSearch(reader, file_name, iterations);
+    this->iteratedLocalSearch(reader, this->results != nullptr ? "" : file_name, iterations);
+    if (this->results != nullptr) {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      this->results->append(i, this->path_cost, elapsed.count(), this->path, this->size);
+    }
     if (best_cost > this->path_cost) {
       best_cost = this->path_cost;
-      best_path = this->path;
+      std::copy(this->path, this->path + this->size, best_path);
     }
   }
-  this->path_cost = best_cost;
-  this->path = best_path;
-  reader->SavePath(file_name, this->path, this->path_cost, this->size);
+  if (node_start < node_finish) {
+    this->path_cost = best_cost;
+    std::copy(best_path, best_path + this->size, this->path);
+  }
+  savePath(reader, file_name);
   std::cout << "Best Score: " << best_cost << std::endl;
   //std::cout << "Best route: " << std::endl;
   //this->printDecisionPath();
 }
 
+// Same as randomNodeStarter, but the start vertices are spread over a
+// work-stealing pool. Every worker searches on its own copy of this TSP and
+// publishes its tour when it beats the best cost seen so far.
+void TSP::parallelRandomNodeStarter(DataReader* reader, std::string file_name, std::string dir_name, long node_start, long node_finish, long iterations, long threads) {
+  if (node_start == -1)
+    node_start = 0;
+  if (node_finish == -1)
+    node_finish = this->size;
+  // No start ran, so best_path was never written: keep the current tour
+  // and save nothing.
+  if (node_start >= node_finish)
+    return;
+
+  ThreadPool pool(threads);
+  std::vector<TSP*> workers;
+  for (long w = 0; w < pool.getThreads(); w++) {
+    workers.push_back(new TSP(*this));
+    workers.back()->threads = 1;
+  }
+
+  std::atomic<double> best_cost(std::numeric_limits<double>::infinity());
+  std::mutex best_mutex;
+  long* best_path = this->workspace.bestStartPath();
+
+  for (long i = node_start; i < node_finish; i++) {
+    pool.submit([&, i](long w) {
+      TSP* tsp = workers[w];
+      auto start = std::chrono::steady_clock::now();
+      tsp->random = this->random.split(i);
+      tsp->createInitialDecision(i);
+      tsp->iteratedLocalSearch(reader, this->results != nullptr ? "" : dir_name + std::to_string(i) + file_name, iterations);
+      if (this->results != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        this->results->append(i, tsp->path_cost, elapsed.count(), tsp->path, tsp->size);
+      }
+
+      double cost = tsp->path_cost;
+      double seen = best_cost.load();
+      while (cost < seen && !best_cost.compare_exchange_weak(seen, cost)) {}
+      if (cost < seen) {
+        std::lock_guard<std::mutex> lock(best_mutex);
+        if (cost <= best_cost.load())
+          std::copy(tsp->path, tsp->path + tsp->size, best_path);
+      }
+    });
+  }
+  pool.wait();
+
+  for (TSP* tsp : workers)
+    delete tsp;
+
+  if (this->path == nullptr)
+    this->path = this->workspace.path();
+  std::copy(best_path, best_path + this->size, this->path);
+  this->path_cost = best_cost.load();
+  savePath(reader, dir_name + "Best" + file_name);
+  std::cout << "Best Score: " << this->path_cost << std::endl;
+}
+
 void TSP::createInitialDecision(int _start_vertex) {
-  this->path = new long[this->size];
-  double** dist_matrix = getDistMatrix();
-  long* visited = new long[this->size]{ 0 };
+  TSP_PHASE(Construction);
+  this->path = this->workspace.path();
+  char* visited = this->workspace.visited();
   long start_vertex = _start_vertex, path_i = 0;
 
   if (start_vertex == -1)
-    start_vertex = std::rand() % size;
+    start_vertex = this->random.below(size);
 
   visited[start_vertex] = 1;
   this->path[path_i] = start_vertex;
   path_i++;
 
-  while (path_i != size) {
-    double min_distance = std::numeric_limits<double>::infinity();
-    long min_i = 0;
-    for (long i = 0; i < size; i++) {
-      if (!visited[i] && dist_matrix[start_vertex][i] < min_distance) {
-        min_distance = dist_matrix[start_vertex][i];
-        min_i = i;
+  withMetric([&](const auto& metric) {
+    while (path_i != size) {
+      double min_distance = std::numeric_limits<double>::infinity();
+      long min_i = 0;
+      for (long i = 0; i < size; i++) {
+        if (!visited[i]) {
+          double d = metric(start_vertex, i);
+          if (d < min_distance) {
+            min_distance = d;
+            min_i = i;
+          }
+        }
       }
+      visited[min_i] = 1;
+      start_vertex = min_i;
+      this->path[path_i++] = start_vertex;
     }
-    visited[min_i] = 1;
-    start_vertex = min_i;
-    this->path[path_i++] = start_vertex;
-  }
+  });
 
-  delete[] visited;
   this->path_cost = calculatePathCost(this->path, this->size);
   //std::cout << "INITIAL COST: " << this->path_cost << std::endl;
   //std::cout << "INITIAL PATH: " << std::endl;
   //this->printDecisionPath();
 }
 
-double TSP::calculatePathCost(long* path, long size, bool pseudo) {
-  double cost = 0.0;
-  long i;
-  for (i = 0; i < size - 1; i++) {
-    long j = i + 1;
-    if (pseudo)
-      cost += dist_pseudo_matrix[path[i]][path[j]];
+// Walks from start to the nearest city not taken yet until the set is
+// empty. The set must hold every city on entry.
+static void nearestNeighbourWalk(UnvisitedCities& cities, long start, long* out) {
+  long path_i = 0;
+  for (long city = start; city != -1; city = cities.nearest(city)) {
+    cities.remove(city);
+    out[path_i++] = city;
+  }
+}
+
+void TSP::createNearestNeighbourTour(const std::vector<node_info>& data, long start_vertex) {
+  TSP_PHASE(Construction);
+  if (this->path == nullptr)
+    this->path = this->workspace.path();
+  if (start_vertex == -1)
+    start_vertex = this->random.below(size);
+
+  KDTree tree(data);
+  UnvisitedCities cities(tree);
+  nearestNeighbourWalk(cities, start_vertex, this->path);
+  this->path_cost = calculatePathCost(this->path, this->size);
+}
+
+// Takes the candidate edges (the candidate lists when they are built,
+// otherwise the k nearest neighbours) shortest first while both ends have
+// degree below two and no cycle closes (union-find), then chains the
+// fragments, each time jumping from the end of the current one to the
+// nearest free end of another.
+void TSP::createGreedyEdgeTour(const std::vector<node_info>& data, long k) {
+  TSP_PHASE(Construction);
+  if (this->path == nullptr)
+    this->path = this->workspace.path();
+  if (this->size < 3) {
+    for (long i = 0; i < this->size; i++)
+      this->path[i] = i;
+    this->path_cost = calculatePathCost(this->path, this->size);
+    return;
+  }
+
+  KDTree tree(data);
+  k = std::min(k, this->size - 1);
+  if (this->neighbours != nullptr)
+    k = std::min(k, this->neighbours_k);
+  std::vector<long> near(k);
+  std::vector<std::pair<long, long>> edges;
+  edges.reserve(this->size * k);
+  for (long a = 0; a < this->size; a++) {
+    const long* found = near.data();
+    if (this->neighbours != nullptr)
+      found = this->neighbours + a * this->neighbours_k;
     else
-      cost += dist_matrix[path[i]][path[j]];
+      tree.nearest(a, k, near.data());
+    for (long i = 0; i < k; i++)
+      edges.push_back(std::make_pair(std::min(a, found[i]), std::max(a, found[i])));
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  std::vector<double> cost(edges.size());
+  std::vector<long> order(edges.size());
+  withMetric([&](const auto& metric) {
+    for (size_t e = 0; e < edges.size(); e++) {
+      cost[e] = metric(edges[e].first, edges[e].second);
+      order[e] = e;
+    }
+  });
+  std::sort(order.begin(), order.end(), [&cost](long e1, long e2) {
+    return cost[e1] < cost[e2] || (cost[e1] == cost[e2] && e1 < e2);
+  });
+
+  std::vector<long> parent(this->size);
+  for (long i = 0; i < this->size; i++)
+    parent[i] = i;
+  auto find = [&parent](long city) {
+    while (parent[city] != city)
+      city = parent[city] = parent[parent[city]];
+    return city;
+  };
+
+  std::vector<long> adj(this->size * 2, -1);
+  std::vector<char> degree(this->size, 0);
+  long taken = 0;
+  for (long e : order) {
+    long a = edges[e].first, b = edges[e].second;
+    if (degree[a] == 2 || degree[b] == 2)
+      continue;
+    long root_a = find(a), root_b = find(b);
+    if (root_a == root_b)
+      continue;
+    parent[root_a] = root_b;
+    adj[a * 2 + degree[a]++] = b;
+    adj[b * 2 + degree[b]++] = a;
+    if (++taken == this->size - 1)
+      break;
+  }
+
+  UnvisitedCities ends(tree);
+  long start = -1;
+  for (long i = 0; i < this->size; i++) {
+    if (degree[i] == 2)
+      ends.remove(i);
+    else if (start == -1)
+      start = i;
+  }
+
+  long path_i = 0;
+  for (long end = start; end != -1; end = ends.nearest(end)) {
+    long prev = -1, city = end;
+    ends.remove(city);
+    while (true) {
+      this->path[path_i++] = city;
+      long next = adj[city * 2] == prev ? adj[city * 2 + 1] : adj[city * 2];
+      if (next == -1)
+        break;
+      prev = city;
+      city = next;
+    }
+    end = city;
+    ends.remove(end);
+  }
+  this->path_cost = calculatePathCost(this->path, this->size);
+}
+
+// Index of (x, y) along the Hilbert curve over a 2^16 x 2^16 grid.
+static unsigned long long hilbertIndex(unsigned long x, unsigned long y) {
+  const unsigned long side = 1UL << 16;
+  unsigned long long d = 0;
+  for (unsigned long s = side / 2; s > 0; s /= 2) {
+    unsigned long rx = (x & s) > 0, ry = (y & s) > 0;
+    d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+void TSP::createSpaceFillingCurveTour(const std::vector<node_info>& data) {
+  TSP_PHASE(Construction);
+  if (this->path == nullptr)
+    this->path = this->workspace.path();
+
+  double min_x = std::numeric_limits<double>::infinity(), max_x = -min_x;
+  double min_y = min_x, max_y = -min_x;
+  for (const node_info& node : data) {
+    min_x = std::min(min_x, node.x);
+    max_x = std::max(max_x, node.x);
+    min_y = std::min(min_y, node.y);
+    max_y = std::max(max_y, node.y);
+  }
+  double span = std::max(max_x - min_x, max_y - min_y);
+  double scale = span > 0 ? 65535.0 / span : 0.0;
+
+  std::vector<std::pair<unsigned long long, long>> keys(this->size);
+  for (long i = 0; i < this->size; i++) {
+    unsigned long x = (unsigned long)((data[i].x - min_x) * scale);
+    unsigned long y = (unsigned long)((data[i].y - min_y) * scale);
+    keys[i] = std::make_pair(hilbertIndex(x, y), i);
   }
+  std::sort(keys.begin(), keys.end());
+  for (long i = 0; i < this->size; i++)
+    this->path[i] = keys[i].second;
+  this->path_cost = calculatePathCost(this->path, this->size);
+}
+
+void TSP::setPath(const long* path) {
+  if (this->path == nullptr)
+    this->path = this->workspace.path();
+  std::copy(path, path + this->size, this->path);
+  this->path_cost = calculatePathCost(this->path, this->size);
+  this->queue_ready = false;
+}
+
+double TSP::calculatePathCost(long* path, long size, bool pseudo) {
   if (pseudo)
-    cost += dist_pseudo_matrix[path[i]][path[0]];
-  else
-    cost += dist_matrix[path[i]][path[0]];
-  return cost;
+    return tourLength([this](long a, long b) { return pseudoDist(a, b); }, path, size);
+  return withMetric([&](const auto& metric) { return tourLength(metric, path, size); });
 }
 
 long* TSP::TwoOptSwap(long& i, long& j, long size) {
-  long* new_path = new long[size] { -1 };
-  
+  long* new_path = this->workspace.swapPath();
+
   for (long m = 0; m < i; m++)
     new_path[m] = this->path[m];
 
@@ -165,73 +483,762 @@ long* TSP::TwoOptSwap(long& i, long& j, long size) {
   return new_path;
 }
 
-bool TSP::localSearch() {
-  std::vector<Change> change_list;
-  double** dist_matrix = getDistMatrix();
+// Gain of reversing path[i..j]: the edges (i - 1, i) and (j, j + 1) are
+// replaced by (i - 1, j) and (i, j + 1), everything else stays the same.
+template <class Metric>
+double TSP::twoOptGain(const Metric& metric, long i, long j) const {
+  if (i == 0 && j == this->size - 1)
+    return 0.0;
 
-  for (long i = 0; i < this->size - 1; i++) {
-    for (long j = i + 1; j < this->size; j++) {
-      long* new_path = TwoOptSwap(i, j, this->size);
-      double cost = calculatePathCost(new_path, this->size);
+  long a = this->path[i == 0 ? this->size - 1 : i - 1];
+  long b = this->path[i];
+  long c = this->path[j];
+  long d = this->path[j + 1 == this->size ? 0 : j + 1];
+  return metric(a, b) + metric(c, d) - metric(a, c) - metric(b, d);
+}
 
-      if (this->first_step) {
+double TSP::twoOptGain(long i, long j) const {
+  return withMetric([&](const auto& metric) { return twoOptGain(metric, i, j); });
+}
 
-        if (cost < this->path_cost) {
-          this->path_cost = cost;
-          delete[] this->path;
-          this->path = new_path;
-          return true;
+void TSP::reversePath(long i, long j) {
+  TSP_COUNT(Reversals, 1);
+  TSP_COUNT(ReversalLength, j - i + 1);
+  while (i < j) {
+    long tmp = this->path[i];
+    this->path[i++] = this->path[j];
+    this->path[j--] = tmp;
+  }
+}
+
+// Best-improvement 2-opt sweep with the i-range split over the pool. Each
+// worker keeps its best move and the results are reduced afterwards,
+// breaking ties by the smallest (i, j) like the sequential sweep.
+bool TSP::parallelLocalSearch() {
+  if (this->pool == nullptr || this->pool->getThreads() != this->threads) {
+    delete this->pool;
+    this->pool = new ThreadPool(this->threads);
+  }
+
+  std::vector<Change>& best = this->workspace.changes;
+  best.resize(this->pool->getThreads());
+  for (Change& change : best) {
+    change.cost = kImproveEps;
+    change.node1 = change.node2 = -1;
+  }
+
+  long grain = std::max(1L, this->size / (8 * this->threads));
+  withMetric([&](const auto& metric) {
+    this->pool->parallelFor(0, this->size - 1, grain, [this, &best, &metric](long worker, long lo, long hi) {
+      Change local = best[worker];
+      for (long i = lo; i < hi; i++) {
+        for (long j = i + 1; j < this->size; j++) {
+          double gain = twoOptGain(metric, i, j);
+          if (gain > local.cost || (gain == local.cost && local.node1 != -1 && i < local.node1)) {
+            local.cost = gain;
+            local.node1 = i;
+            local.node2 = j;
+          }
         }
       }
-      else {
-        Change change;
-        change.cost = cost;
-        change.node1 = i;
-        change.node2 = j;
-        change_list.push_back(change);
+      best[worker] = local;
+    });
+  });
+
+  Change best_change = best[0];
+  for (const Change& change : best) {
+    if (change.node1 == -1)
+      continue;
+    if (best_change.node1 == -1 || change.cost > best_change.cost ||
+        (change.cost == best_change.cost && change.node1 < best_change.node1))
+      best_change = change;
+  }
+
+  countEvaluated((long long)this->size * (this->size - 1) / 2);
+  if (best_change.node1 == -1)
+    return false;
+
+  reversePath(best_change.node1, best_change.node2);
+  this->path_cost -= best_change.cost;
+  TSP_COUNT(MovesAccepted, 1);
+  return true;
+}
+
+void TSP::setCoordinates(const std::vector<node_info>& data, EdgeWeightType type) {
+  this->city_x.clear();
+  this->city_y.clear();
+  if (type != EdgeWeightType::RAW)
+    return;
+  for (const node_info& node : data) {
+    this->city_x.push_back(node.x);
+    this->city_y.push_back(node.y);
+  }
+}
+
+// Full 2-opt sweep where the gains of a row i are computed by the widest
+// SIMD kernel of the CPU straight from the coordinates. Rows are first
+// bounded in single precision, and only those that may hold a better move
+// than the best so far go through the double kernel, so the sweep accepts
+// the same move as the scalar one.
+bool TSP::simdLocalSearch() {
+  static const TwoOptRowKernel kernel = selectTwoOptKernel();
+  static const TwoOptScreenKernel screen = selectTwoOptScreenKernel();
+  long n = this->size;
+  this->tour_x.resize(n + 1);
+  this->tour_y.resize(n + 1);
+  this->edge_len.resize(n);
+  this->row_gains.resize(n);
+  for (long k = 0; k <= n; k++) {
+    long city = this->path[k == n ? 0 : k];
+    this->tour_x[k] = this->city_x[city];
+    this->tour_y[k] = this->city_y[city];
+  }
+  double wrap_gain = 0.0;
+  withMetric([&](const auto& metric) {
+    for (long k = 0; k < n; k++)
+      this->edge_len[k] = metric(this->path[k], this->path[k + 1 == n ? 0 : k + 1]);
+    wrap_gain = twoOptGain(metric, 0, n - 1);
+  });
+
+  // Each float gain sums four distances, each off by less than ten float
+  // epsilons (2^-24) of the coordinate extent; 1e-5 of the extent bounds
+  // the total error with room to spare.
+  double screen_slack = 0.0;
+  if (screen != nullptr) {
+    double min_x = *std::min_element(this->tour_x.begin(), this->tour_x.end());
+    double min_y = *std::min_element(this->tour_y.begin(), this->tour_y.end());
+    double extent = std::max(*std::max_element(this->tour_x.begin(), this->tour_x.end()) - min_x,
+                             *std::max_element(this->tour_y.begin(), this->tour_y.end()) - min_y);
+    screen_slack = 1e-5 * extent;
+    this->screen_x.resize(n + 1);
+    this->screen_y.resize(n + 1);
+    this->screen_len.resize(n);
+    for (long k = 0; k <= n; k++) {
+      this->screen_x[k] = (float)(this->tour_x[k] - min_x);
+      this->screen_y[k] = (float)(this->tour_y[k] - min_y);
+    }
+    for (long k = 0; k < n; k++)
+      this->screen_len[k] = (float)this->edge_len[k];
+  }
+
+  Change best_change;
+  best_change.cost = kImproveEps;
+  best_change.node1 = best_change.node2 = -1;
+  double* gains = this->row_gains.data();
+
+  for (long i = 0; i < n - 1; i++) {
+    long prev_i = i == 0 ? n - 1 : i - 1;
+    // (0, n - 1) reverses the whole tour and is left to the scalar gain.
+    long hi = i == 0 ? n - 1 : n;
+    countEvaluated(n - i - 1);
+    if (screen != nullptr && (i != 0 || wrap_gain <= best_change.cost)) {
+      const float* sx = this->screen_x.data();
+      const float* sy = this->screen_y.data();
+      float bound = screen(sx, sy, this->screen_len.data(), sx[prev_i], sy[prev_i], sx[i], sy[i],
+                           this->screen_len[prev_i], i + 1, hi);
+      if (bound + screen_slack <= best_change.cost)
+        continue;
+    }
+    double row_best = kernel(this->tour_x.data(), this->tour_y.data(), this->edge_len.data(),
+                             this->tour_x[prev_i], this->tour_y[prev_i], this->tour_x[i], this->tour_y[i],
+                             this->edge_len[prev_i], i + 1, hi, gains);
+    if (i == 0) {
+      gains[n - 1] = wrap_gain;
+      row_best = std::max(row_best, gains[n - 1]);
+      hi = n;
+    }
+    if (row_best <= best_change.cost)
+      continue;
+
+    for (long j = i + 1; j < hi; j++) {
+      if (gains[j] > best_change.cost) {
+        best_change.cost = gains[j];
+        best_change.node1 = i;
+        best_change.node2 = j;
+        if (this->first_step)
+          break;
+      }
+    }
+    if (this->first_step)
+      break;
+  }
+
+  if (best_change.node1 == -1)
+    return false;
+
+  reversePath(best_change.node1, best_change.node2);
+  this->path_cost -= best_change.cost;
+  TSP_COUNT(MovesAccepted, 1);
+  return true;
+}
+
+bool TSP::localSearch() {
+  if (this->use_candidates && this->neighbours != nullptr)
+    return candidateLocalSearch();
+  if (this->use_simd && (long)this->city_x.size() == this->size)
+    return simdLocalSearch();
+  if (!this->first_step && this->threads > 1)
+    return parallelLocalSearch();
+
+  Change best_change;
+  best_change.cost = kImproveEps;
+  best_change.node1 = best_change.node2 = -1;
+
+  withMetric([&](const auto& metric) {
+    for (long i = 0; i < this->size - 1; i++) {
+      countEvaluated(this->size - i - 1);
+      for (long j = i + 1; j < this->size; j++) {
+        double gain = twoOptGain(metric, i, j);
+        if (gain <= best_change.cost)
+          continue;
+
+        best_change.cost = gain;
+        best_change.node1 = i;
+        best_change.node2 = j;
+        if (this->first_step)
+          return;
+      }
+    }
+  });
+
+  if (best_change.node1 == -1)
+    return false;
+
+  reversePath(best_change.node1, best_change.node2);
+  this->path_cost -= best_change.cost;
+  TSP_COUNT(MovesAccepted, 1);
+  return true;
+}
+
+void TSP::buildCandidateLists(const std::vector<node_info>& data, long k) {
+  KDTree tree(data);
+  k = std::min(k, this->size - 1);
+
+  delete[] this->neighbours;
+  this->neighbours = new long[this->size * k];
+  this->neighbours_k = k;
+  for (long city = 0; city < this->size; city++)
+    tree.nearest(city, k, this->neighbours + city * k);
+}
+
+void TSP::syncPositions() {
+  if (this->size >= this->two_level_min_size) {
+    if (this->list == nullptr)
+      this->list = new TwoLevelList(this->path, this->size);
+    else
+      this->list->assign(this->path);
+    return;
+  }
+  delete this->list;
+  this->list = nullptr;
+
+  if (this->position == nullptr)
+    this->position = this->workspace.position();
+  for (long i = 0; i < this->size; i++)
+    this->position[this->path[i]] = i;
+}
+
+void TSP::exportTour() {
+  if (this->list != nullptr)
+    this->list->toArray(this->path);
+}
+
+// Reverses the cyclic stretch of the tour from position `from` forward to
+// position `to`. The complementary stretch is reversed instead when it is
+// shorter, which yields the same cycle.
+void TSP::reverseTour(long from, long to) {
+  long len = to - from;
+  if (len < 0)
+    len += this->size;
+  len += 1;
+  if (2 * len > this->size) {
+    long tmp = from;
+    from = to + 1 == this->size ? 0 : to + 1;
+    to = tmp == 0 ? this->size - 1 : tmp - 1;
+    len = this->size - len;
+  }
+  TSP_COUNT(Reversals, 1);
+  TSP_COUNT(ReversalLength, len);
+
+  for (long swaps = len / 2; swaps > 0; swaps--) {
+    long a = this->path[from], b = this->path[to];
+    this->path[from] = b;
+    this->position[b] = from;
+    this->path[to] = a;
+    this->position[a] = to;
+    from = from + 1 == this->size ? 0 : from + 1;
+    to = to == 0 ? this->size - 1 : to - 1;
+  }
+}
+
+// Replaces the tour edges (a, b) and (c, d) by (a, c) and (b, d), where b
+// follows a and d follows c in either orientation of the tour.
+void TSP::make2OptMove(long a, long b, long c, long d) {
+  if (this->flip_log != nullptr)
+    this->flip_log->push_back({ a, b, c, d });
+
+  if (this->list != nullptr) {
+    if (this->list->next(a) == b)
+      this->list->reverse(b, c);
+    else
+      this->list->reverse(a, d);
+  }
+  else if (next(a) == b)
+    reverseTour(this->position[b], this->position[c]);
+  else
+    reverseTour(this->position[a], this->position[d]);
+}
+
+// Best improving 2-opt move that connects a to one of its candidate
+// neighbours closer than its current tour neighbour, in either direction.
+// Returns the gain of the move, 0 when there is none.
+template <class Metric>
+double TSP::bestTwoOptMove(const Metric& metric, long a, Flip& move) {
+  long* cand = this->neighbours + a * this->neighbours_k;
+  double best_gain = kImproveEps;
+  bool found = false;
+
+  for (int direction = 0; direction < 2; direction++) {
+    long b = direction == 0 ? next(a) : prev(a);
+    double d_ab = metric(a, b);
+
+    for (long m = 0; m < this->neighbours_k; m++) {
+      long c = cand[m];
+      double g1 = d_ab - metric(a, c);
+      if (g1 <= 0)
+        break;
+
+      long d = direction == 0 ? next(c) : prev(c);
+      if (c == b || d == a)
+        continue;
+
+      double gain = g1 + metric(c, d) - metric(b, d);
+      countEvaluated(1);
+      if (gain <= best_gain)
+        continue;
+
+      best_gain = gain;
+      found = true;
+      if (direction == 0)
+        move = { a, b, c, d };
+      else
+        move = { b, a, d, c };
+      if (this->first_step)
+        return best_gain;
+    }
+  }
+  return found ? best_gain : 0.0;
+}
+
+// 2-opt restricted to moves where a city gets connected to one of its
+// candidate neighbours.
+bool TSP::candidateLocalSearch() {
+  syncPositions();
+  double best_gain = kImproveEps;
+  Flip best_move;
+  bool found = false;
+
+  withMetric([&](const auto& metric) {
+    for (long i = 0; i < this->size; i++) {
+      Flip move;
+      double gain = bestTwoOptMove(metric, this->path[i], move);
+      if (gain > best_gain) {
+        best_gain = gain;
+        best_move = move;
+        found = true;
+        if (this->first_step)
+          break;
       }
+    }
+  });
+
+  if (!found)
+    return false;
+
+  make2OptMove(best_move.a, best_move.b, best_move.c, best_move.d);
+  exportTour();
+  this->path_cost -= best_gain;
+  TSP_COUNT(MovesAccepted, 1);
+  return true;
+}
+
+// Moves the segment s1..s2 (s2 follows s1) between c and d = next(c),
+// optionally reversed, as a chain of 2-opt moves.
+void TSP::makeOrOptMove(long s1, long s2, long c, long d, bool reversed) {
+  long p = prev(s1), n = next(s2);
+  if (d == p) {
+    // c p s1..s2 n: the segment and p trade places, and the first move of
+    // the general chain would break the edge (c, p) twice.
+    make2OptMove(c, p, s2, n);
+    // c s2..s1 p n
+    if (!reversed && s1 != s2)
+      make2OptMove(c, s2, s1, p);
+    return;
+  }
+  // p c..n s2..s1 d
+  make2OptMove(p, s1, c, d);
+  // p n..c s2..s1 d
+  make2OptMove(p, c, n, s2);
+  if (!reversed && s1 != s2)
+    make2OptMove(c, s2, s1, d);
+}
 
-      delete[] new_path;
+// Best Or-opt move of the 1-3 city segments starting at s1:
+// the segment is relocated to another edge of the tour, optionally
+// reversed. With candidate lists only edges next to a candidate of a
+// segment end are tried, otherwise every edge is. The move is returned
+// as { s1, s2, c, d } together with its gain, 0 when there is none.
+template <class Metric>
+double TSP::bestOrOptMove(const Metric& metric, long s1, Flip& move, bool& reversed) {
+  const long kMaxSegment = 3;
+  bool use_lists = this->use_candidates && this->neighbours != nullptr;
+  double best_gain = kImproveEps;
+  bool found = false;
+  long p = prev(s1);
+  long mid = next(s1);
+  long s2 = s1;
 
+  for (long len = 1; len <= kMaxSegment; len++) {
+    if (len > 1)
+      s2 = next(s2);
+    long n = next(s2);
+    double remove_gain = metric(p, s1) + metric(s2, n) - metric(p, n);
+    if (remove_gain <= best_gain)
+      continue;
+
+    auto inSegment = [&](long city) {
+      return city == s1 || city == s2 || (len == 3 && city == mid);
+    };
+    auto tryEdge = [&](long c, long d) {
+      if (inSegment(c) || inSegment(d))
+        return;
+      double base = remove_gain + metric(c, d);
+      double gain = base - metric(c, s1) - metric(s2, d);
+      countEvaluated(len > 1 ? 2 : 1);
+      if (gain > best_gain) {
+        best_gain = gain;
+        move = { s1, s2, c, d };
+        reversed = false;
+        found = true;
+      }
+      gain = base - metric(c, s2) - metric(s1, d);
+      if (len > 1 && gain > best_gain) {
+        best_gain = gain;
+        move = { s1, s2, c, d };
+        reversed = true;
+        found = true;
+      }
+    };
+
+    if (use_lists) {
+      for (int end = 0; end < 2; end++) {
+        long s = end == 0 ? s1 : s2;
+        long* cand = this->neighbours + s * this->neighbours_k;
+        for (long m = 0; m < this->neighbours_k; m++) {
+          long c = cand[m];
+          if (metric(s, c) >= remove_gain)
+            break;
+          tryEdge(c, next(c));
+          tryEdge(prev(c), c);
+        }
+      }
+    }
+    else {
+      for (long j = 0; j < this->size; j++)
+        tryEdge(this->path[j], next(this->path[j]));
     }
+
+    if (this->first_step && found)
+      break;
   }
+  return found ? best_gain : 0.0;
+}
 
-  if (change_list.size() == 0)
+bool TSP::orOptSearch() {
+  if (this->size < 8)
     return false;
 
-  Change min_change;
+  syncPositions();
+  double best_gain = kImproveEps;
+  Flip best_move;
+  bool best_reversed = false, found = false;
+
+  withMetric([&](const auto& metric) {
+    for (long i = 0; i < this->size; i++) {
+      Flip move;
+      bool reversed = false;
+      double gain = bestOrOptMove(metric, this->path[i], move, reversed);
+      if (gain > best_gain) {
+        best_gain = gain;
+        best_move = move;
+        best_reversed = reversed;
+        found = true;
+        if (this->first_step)
+          break;
+      }
+    }
+  });
+
+  if (!found)
+    return false;
+
+  makeOrOptMove(best_move.a, best_move.b, best_move.c, best_move.d, best_reversed);
+  exportTour();
+  this->path_cost -= best_gain;
+  TSP_COUNT(MovesAccepted, 1);
+  return true;
+}
+
+// Variable-depth step from t1 in the Lin-Kernighan manner, built from
+// sequential 2-opt moves: the edge (t1, t2) is broken, t2 is joined to a
+// candidate t3 and the tour is closed through t3's neighbour t4, which
+// becomes the new t2. Every candidate is tried on the first level, deeper
+// levels follow the best one only. The chain goes on while the partial gain
+// stays positive and is rolled back to its most profitable closing point.
+template <class Metric>
+bool TSP::improveFromCity(const Metric& metric, long t1, std::vector<Flip>& flips) {
+  for (int direction = 0; direction < 2; direction++) {
+    long first_t2 = direction == 0 ? next(t1) : prev(t1);
+    long* first_cand = this->neighbours + first_t2 * this->neighbours_k;
+
+    for (long first = 0; first < this->neighbours_k; first++) {
+      long t2 = first_t2;
+      double gain = metric(t1, t2);
+      if (gain - metric(t2, first_cand[first]) <= 0)
+        break;
+
+      double best_close = kImproveEps;
+      size_t best_depth = 0;
+      flips.clear();
+
+      for (long depth = 0; depth < this->lk_max_depth; depth++) {
+        bool forward = next(t1) == t2;
+        long* cand = this->neighbours + t2 * this->neighbours_k;
+        long t3 = -1, t4 = -1;
+        double best_value = -std::numeric_limits<double>::infinity();
+
+        long m_begin = depth == 0 ? first : 0;
+        long m_end = depth == 0 ? first + 1 : this->neighbours_k;
+        for (long m = m_begin; m < m_end; m++) {
+          long c = cand[m];
+          double g1 = gain - metric(t2, c);
+          if (g1 <= 0)
+            break;
+          long d = forward ? prev(c) : next(c);
+          if (c == t1 || d == t2)
+            continue;
+          double value = g1 + metric(c, d);
+          countEvaluated(1);
+          if (value > best_value) {
+            best_value = value;
+            t3 = c;
+            t4 = d;
+          }
+        }
+        if (t3 == -1)
+          break;
+
+        Flip flip;
+        if (forward)
+          flip = { t1, t2, t4, t3 };
+        else
+          flip = { t2, t1, t3, t4 };
+        make2OptMove(flip.a, flip.b, flip.c, flip.d);
+        flips.push_back(flip);
+
+        gain = best_value;
+        double close = gain - metric(t4, t1);
+        if (close > best_close) {
+          best_close = close;
+          best_depth = flips.size();
+        }
+        t2 = t4;
+      }
 
-  min_change.cost = std::numeric_limits<double>::infinity();
-  for (auto& change : change_list) {
-    if (change.cost < min_change.cost)
-      min_change = change;
+      // Undo the flips past the best closing point, newest first.
+      for (size_t k = flips.size(); k > best_depth; k--) {
+        const Flip& flip = flips[k - 1];
+        make2OptMove(flip.a, flip.c, flip.b, flip.d);
+      }
+      if (best_depth > 0) {
+        flips.resize(best_depth);
+        this->path_cost -= best_close;
+        TSP_COUNT(MovesAccepted, 1);
+        return true;
+      }
+    }
   }
+  return false;
+}
 
-  if (min_change.cost < this->path_cost) {
-    long* new_path = TwoOptSwap(min_change.node1, min_change.node2, this->size);
-    delete[] this->path;
-    this->path = new_path;
-    this->path_cost = min_change.cost;
-    return true;
+bool TSP::linKernighanSearch() {
+  if (this->neighbours == nullptr)
+    return localSearch();
+
+  syncPositions();
+  std::vector<Flip>& flips = this->workspace.flips;
+  bool improved = false;
+  withMetric([&](const auto& metric) {
+    for (long i = 0; i < this->size; i++)
+      if (improveFromCity(metric, this->path[i], flips))
+        improved = true;
+  });
+  exportTour();
+  return improved;
+}
+
+void TSP::resetDontLookBits() {
+  if (this->queued == nullptr)
+    this->queued = this->workspace.queued();
+  this->workspace.clearQueue();
+  for (long i = 0; i < this->size; i++) {
+    this->queued[this->path[i]] = 1;
+    this->workspace.push(this->path[i]);
+  }
+  this->queue_ready = true;
+}
+
+void TSP::activate(long city) {
+  if (!this->queued[city]) {
+    this->queued[city] = 1;
+    this->workspace.push(city);
+  }
+}
+
+// Applies the first improving move found around city and queues the
+// endpoints of every edge it changed.
+template <class Metric>
+bool TSP::improveCity(const Metric& metric, long city, std::vector<Flip>& flips) {
+  if (this->use_lin_kernighan) {
+    if (improveFromCity(metric, city, flips)) {
+      for (const Flip& flip : flips) {
+        activate(flip.a); activate(flip.b); activate(flip.c); activate(flip.d);
+      }
+      return true;
+    }
   }
-  else 
+  else {
+    Flip move;
+    double gain = bestTwoOptMove(metric, city, move);
+    if (gain > 0) {
+      make2OptMove(move.a, move.b, move.c, move.d);
+      this->path_cost -= gain;
+      TSP_COUNT(MovesAccepted, 1);
+      activate(move.a); activate(move.b); activate(move.c); activate(move.d);
+      return true;
+    }
+  }
+
+  if (!this->use_or_opt || this->size < 8)
     return false;
+
+  // Every segment of up to three cities that contains city.
+  long s1 = city;
+  for (long shift = 0; shift < 3; shift++, s1 = prev(s1)) {
+    Flip move;
+    bool reversed = false;
+    double gain = bestOrOptMove(metric, s1, move, reversed);
+    if (gain > 0) {
+      long p = prev(move.a), n = next(move.b);
+      makeOrOptMove(move.a, move.b, move.c, move.d, reversed);
+      this->path_cost -= gain;
+      TSP_COUNT(MovesAccepted, 1);
+      activate(p); activate(n); activate(move.a); activate(move.b);
+      activate(move.c); activate(move.d);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Local search driven by don't-look bits: only queued cities are examined,
+// and a city goes back to the queue only when one of its tour edges
+// changes. Runs until the queue is empty.
+bool TSP::queueSearch() {
+  syncPositions();
+  if (!this->queue_ready)
+    resetDontLookBits();
+
+  bool improved = drainQueue();
+  exportTour();
+  return improved;
+}
+
+bool TSP::localSearchAround(const std::vector<long>& cities) {
+  if (this->neighbours == nullptr)
+    return false;
+  syncPositions();
+  if (this->queued == nullptr)
+    this->queued = this->workspace.queued();
+  std::fill(this->queued, this->queued + this->size, 0);
+  this->workspace.clearQueue();
+  for (long city : cities)
+    activate(city);
+
+  bool improved = drainQueue();
+  exportTour();
+  this->queue_ready = false;
+  return improved;
+}
+
+template <class Metric>
+bool TSP::drainQueue(const Metric& metric) {
+  TSP_PHASE(LocalSearch);
+  std::vector<Flip>& flips = this->workspace.flips;
+  bool improved = false;
+  while (!this->workspace.queueEmpty()) {
+    long city = this->workspace.pop();
+    this->queued[city] = 0;
+    if (improveCity(metric, city, flips)) {
+      improved = true;
+      activate(city);
+    }
+  }
+  return improved;
+}
+
+bool TSP::drainQueue() {
+  return withMetric([this](const auto& metric) { return drainQueue(metric); });
+}
+
+// One improving move: 2-opt (or Lin-Kernighan) first, Or-opt once it is
+// stuck. With don't-look bits the whole descent happens in one step.
+bool TSP::searchStep() {
+  if (this->use_dont_look_bits && this->neighbours != nullptr)
+    return this->queueSearch();
+
+  TSP_PHASE(LocalSearch);
+  bool improved = this->use_lin_kernighan ? this->linKernighanSearch() : this->localSearch();
+  if (improved)
+    return true;
+  return this->use_or_opt && this->orOptSearch();
+}
+
+void TSP::savePath(DataReader* reader, const std::string& file_name) {
+  if (file_name.empty())
+    return;
+  TSP_PHASE(Io);
+  if (this->checkpoint != nullptr)
+    this->checkpoint->submit(file_name, this->path, this->size, this->path_cost);
+  else
+    reader->SavePath(file_name, this->path, this->path_cost, this->size);
 }
 
 void TSP::iteratedLocalSearch(DataReader* reader, std::string file_name, long iterations) {
+  this->queue_ready = false;
   if (iterations == -1) {
     long i = 0;
-    while (this->localSearch()) {
+    while (this->searchStep()) {
       //std::cout << "Iteration: " << i + 1 << " COST: " << this->path_cost << std::endl;
       i++;
-      reader->SavePath(file_name, this->path, this->path_cost, this->size);
+      savePath(reader, file_name);
     }
   }
   else
     for (long i = 0; i < iterations; i++) {
       //std::cout << "Iteration: " << i + 1 << " COST: " << this->path_cost << std::endl;
-      bool result = this->localSearch();
-      reader->SavePath(file_name, this->path, this->path_cost, this->size);
+      bool result = this->searchStep();
+      savePath(reader, file_name);
       if (!result)
         return;
     }
@@ -240,20 +1247,176 @@ void TSP::iteratedLocalSearch(DataReader* reader, std::string file_name, long it
   //this->printDecisionPath();
 }
 
+// Applies a random kick around a random city and queues the endpoints of
+// the changed edges. Returns the change of the tour length.
+double TSP::applyKick() {
+  TSP_PHASE(Kick);
+  long span = std::max(2L, std::min(this->kick_length, (this->size - 2) / 2));
+  long a2 = this->kick_cities.empty() ? this->random.below(this->size)
+                                      : this->kick_cities[this->random.below(this->kick_cities.size())];
+  long b1 = next(a2);
+
+  if (this->kick == Kick::SegmentReversal) {
+    long c = b1;
+    for (long steps = 1 + this->random.below(span); steps > 0; steps--)
+      c = next(c);
+    long d = next(c);
+    double delta = withMetric([&](const auto& metric) {
+      return metric(a2, c) + metric(b1, d) - metric(a2, b1) - metric(c, d);
+    });
+    make2OptMove(a2, b1, c, d);
+    activate(a2); activate(b1); activate(c); activate(d);
+    return delta;
+  }
+
+  // Double bridge a2 [b1..b2] [c1..c2] d1 -> a2 [c1..c2] [b1..b2] d1, done
+  // as three sequential 2-opt moves.
+  long b2 = b1;
+  for (long steps = this->random.below(span); steps > 0; steps--)
+    b2 = next(b2);
+  long c1 = next(b2), c2 = c1;
+  for (long steps = this->random.below(span); steps > 0; steps--)
+    c2 = next(c2);
+  long d1 = next(c2);
+  double delta = withMetric([&](const auto& metric) {
+    return metric(a2, c1) + metric(c2, b1) + metric(b2, d1)
+      - metric(a2, b1) - metric(b2, c1) - metric(c2, d1);
+  });
+
+  make2OptMove(a2, b1, c2, d1);
+  make2OptMove(a2, c2, c1, b2);
+  make2OptMove(c2, b2, b1, d1);
+  activate(a2); activate(b1); activate(b2); activate(c1); activate(c2); activate(d1);
+  return delta;
+}
+
+// Iterated local search: kick the tour, re-optimize only around the kicked
+// edges with the don't-look-bit queue, then keep or roll back the result
+// by the acceptance rule. Stops after `kicks` kicks or `seconds` seconds
+// (-1 = no limit) and leaves the best tour found. Needs candidate lists,
+// without them it is a plain iteratedLocalSearch.
+void TSP::iteratedKickSearch(DataReader* reader, std::string file_name, long kicks, double seconds) {
+  if (this->neighbours == nullptr || this->size < 8) {
+    iteratedLocalSearch(reader, file_name);
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+
+  syncPositions();
+  resetDontLookBits();
+  drainQueue();
+  exportTour();
+
+  double current_cost = this->path_cost;
+  double best_cost = this->path_cost;
+  if (this->best_trace != nullptr)
+    this->best_trace->push_back(std::make_pair(secondsSince(start), best_cost));
+  long* best_path = this->workspace.bestKickPath();
+  std::copy(this->path, this->path + this->size, best_path);
+  std::vector<Flip>& log = this->workspace.log;
+
+  for (long k = 0; kicks < 0 || k < kicks; k++) {
+    if (seconds >= 0 && secondsSince(start) >= seconds)
+      break;
+
+    log.clear();
+    this->flip_log = &log;
+    this->path_cost += applyKick();
+    drainQueue();
+    this->flip_log = nullptr;
+
+    bool accept;
+    if (this->acceptance == Acceptance::Better)
+      accept = this->path_cost < current_cost - kImproveEps;
+    else if (this->acceptance == Acceptance::BetterOrEqual)
+      accept = this->path_cost <= current_cost + kImproveEps;
+    else
+      accept = this->path_cost <= best_cost * (1.0 + this->accept_threshold);
+
+    if (!accept) {
+      for (size_t m = log.size(); m > 0; m--)
+        make2OptMove(log[m - 1].a, log[m - 1].c, log[m - 1].b, log[m - 1].d);
+      this->path_cost = current_cost;
+      continue;
+    }
+
+    current_cost = this->path_cost;
+    if (current_cost < best_cost - kImproveEps) {
+      best_cost = current_cost;
+      if (this->best_trace != nullptr)
+        this->best_trace->push_back(std::make_pair(secondsSince(start), best_cost));
+      exportTour();
+      std::copy(this->path, this->path + this->size, best_path);
+      savePath(reader, file_name);
+    }
+  }
+
+  std::copy(best_path, best_path + this->size, this->path);
+  this->path_cost = best_cost;
+  this->queue_ready = false;
+}
+
 void TSP::finBestGreedy(long vertex_num) {
   double best_cost = std::numeric_limits<double>::infinity();
-  long* best_path = nullptr;
+  long* best_path = this->workspace.bestStartPath();
 
   for (unsigned int i = 0; i < vertex_num; i++) {
     std::cout << "FROM VERTEX: " << i << std::endl;
     createInitialDecision(i);
     if (this->path_cost < best_cost) {
       best_cost = this->path_cost;
-      best_path = this->path;
+      std::copy(this->path, this->path + this->size, best_path);
     }
   }
-  this->path_cost = best_cost;
-  this->path = best_path;
+  if (vertex_num > 0) {
+    this->path_cost = best_cost;
+    std::copy(best_path, best_path + this->size, this->path);
+  }
+
+  std::cout << "BEST GREEDY COST: " << best_cost << std::endl;
+}
+
+void TSP::finBestGreedy(long vertex_num, const std::vector<node_info>& data, long threads) {
+  vertex_num = std::min(vertex_num, this->size);
+  KDTree tree(data);
+  ThreadPool pool(threads);
+
+  struct Worker {
+    UnvisitedCities cities;
+    std::vector<long> path;
+    long best_start = -1;
+    double best_cost = std::numeric_limits<double>::infinity();
+    Worker(const KDTree& tree, long size) : cities(tree), path(size) {}
+  };
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (long w = 0; w < pool.getThreads(); w++)
+    workers.emplace_back(new Worker(tree, this->size));
+
+  pool.parallelFor(0, vertex_num, 1, [&](long w, long lo, long hi) {
+    TSP_PHASE(Construction);
+    Worker& worker = *workers[w];
+    for (long i = lo; i < hi; i++) {
+      worker.cities.reset();
+      nearestNeighbourWalk(worker.cities, i, worker.path.data());
+      double cost = calculatePathCost(worker.path.data(), this->size);
+      if (cost < worker.best_cost) {
+        worker.best_cost = cost;
+        worker.best_start = i;
+      }
+    }
+  });
+
+  long best_start = -1;
+  double best_cost = std::numeric_limits<double>::infinity();
+  for (const auto& worker : workers) {
+    if (worker->best_cost < best_cost ||
+        (worker->best_cost == best_cost && worker->best_start < best_start)) {
+      best_cost = worker->best_cost;
+      best_start = worker->best_start;
+    }
+  }
+  if (best_start != -1)
+    createNearestNeighbourTour(data, best_start);
 
   std::cout << "BEST GREEDY COST: " << best_cost << std::endl;
 }
\ No newline at end of file
@@ -8,19 +8,20 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <limits>
+#include <algorithm>
+#include "DistanceProvider.h"
+#include "Metric.h"
+#include "TSPLibReader.h"
+#include "DistanceMatrixBuilder.h"
+#include "TwoLevelList.h"
+#include "Instrumentation.h"
+#include "Random.h"
+#include "TourWorkspace.h"
 
-struct node_info {
-  long id;
-  double x;
-  double y;
-};
-
-
-struct Change {
-  double cost;
-  long node1;
-  long node2;
-};
+class ThreadPool;
+class CheckpointWriter;
+class ResultsStore;
 
 
 class DataReader {
@@ -29,43 +30,40 @@ public:
   double** dist_pseudo_matrix;
   long node_num;
   std::vector<node_info> data;
+  std::string name;
+  EdgeWeightType edge_weight_type;
+  // False when the file could not be read or its edge weight type is not
+  // supported; node_num is 0 then.
+  bool loaded;
 
-  DataReader(std::string file_name) {
-    std::ifstream infile(file_name);
-
-    long id;
-    double x, y;
-    while (infile >> id >> x >> y) {
-      node_info nf;
-      nf.id = id;
-      nf.x = x;
-      nf.y = y;
-      data.push_back(nf);
+  // Reads TSPLIB files as well as bare "id x y" files, see readTSPLib.
+  // Without build_matrices only the coordinates are kept and dist_matrix
+  // stays nullptr, for use with a matrix-free DistanceProvider (see
+  // makeDistance). dist_pseudo_matrix is no longer built and is always
+  // nullptr: pseudo distances come from PseudoEuclideanFormula or, in TSP,
+  // from dist_matrix / sqrt(10).
+  DataReader(std::string file_name, bool build_matrices = true) {
+    TSPLibInstance instance;
+    loaded = readTSPLib(file_name, instance);
+    if (!loaded) {
+      std::cerr << "Cannot read " << file_name
+                << ": missing file or unsupported EDGE_WEIGHT_TYPE" << std::endl;
+      instance.nodes.clear();
     }
+    name = instance.name;
+    edge_weight_type = instance.edge_weight_type;
+    data.swap(instance.nodes);
 
     node_num = data.size();
+    dist_matrix = dist_pseudo_matrix = nullptr;
+    if (!build_matrices)
+      return;
+
     dist_matrix = new double* [node_num];
-    dist_pseudo_matrix = new double* [node_num];
-    for (long i = 0; i < node_num; i++) {
+    for (long i = 0; i < node_num; i++)
       dist_matrix[i] = new double[node_num];
-      dist_pseudo_matrix[i] = new double[node_num];
-    }
 
-    for (long i = 0; i < node_num; i++) {
-      for (long j = i; j < node_num; j++) {
-        // 0 in diag.
-        if (i == j) {
-          dist_matrix[i][j] = 0.0;
-        }
-        double length = std::sqrt(std::pow(data[j].x - data[i].x, 2) + std::pow(data[j].y - data[i].y, 2));
-        double pseudo_length = std::sqrt((std::pow(data[j].x - data[i].x, 2) + std::pow(data[j].y - data[i].y, 2)) / 10.0);
-        dist_matrix[i][j] = length;
-        dist_matrix[j][i] = length;
-
-        dist_pseudo_matrix[i][j] = pseudo_length;
-        dist_pseudo_matrix[j][i] = pseudo_length;
-      }
-    }
+    buildDistanceMatrices(data, edge_weight_type, dist_matrix, nullptr);
   }
 
   void saveGraphEdges(long* path, std::string file_name) {
@@ -100,17 +98,172 @@ class TSP {
 private:
   long size;
   double path_cost;
+  // Tour, positions, queue and scratch buffers; path and position point
+  // into it once set.
+  TourWorkspace workspace;
   long* path;
   double** dist_matrix;
   double** dist_pseudo_matrix;
+  const DistanceProvider* distance;
+  bool owns_distance;
+  // position[city] is the index of city in path, kept in sync by the
+  // candidate list search. Large tours use the two-level list instead and
+  // path is only written back when a search returns.
+  long* position = nullptr;
+  TwoLevelList* list = nullptr;
+  // neighbours[city * neighbours_k + m] is the m-th nearest city.
+  long* neighbours = nullptr;
+  long neighbours_k = 0;
+
+  double dist(long a, long b) const {
+    return dist_matrix != nullptr ? dist_matrix[a][b] : distance->distance(a, b);
+  }
+  // The distance / sqrt(10). For RAW instances that is the old pseudo
+  // matrix; for TSPLIB types it scales the rounded distance of the type,
+  // not the raw Euclidean one.
+  double pseudoDist(long a, long b) const {
+    return dist_pseudo_matrix != nullptr ? dist_pseudo_matrix[a][b] : dist(a, b) / std::sqrt(10.0);
+  }
+  long next(long city) const {
+    if (list != nullptr)
+      return list->next(city);
+    return path[position[city] + 1 == size ? 0 : position[city] + 1];
+  }
+  long prev(long city) const {
+    if (list != nullptr)
+      return list->prev(city);
+    return path[position[city] == 0 ? size - 1 : position[city] - 1];
+  }
+  void syncPositions();
+  void exportTour();
+  void reverseTour(long from, long to);
+  void make2OptMove(long a, long b, long c, long d);
+  // queued[city] is set while city waits in the workspace queue of cities
+  // whose neighbourhood changed since they were last examined (its
+  // don't-look bit is off while queued).
+  char* queued = nullptr;
+  bool queue_ready = false;
+  ThreadPool* pool = nullptr;
+  // City coordinates for the SIMD sweep, and the structure-of-arrays
+  // scratch it works on: tour_x/tour_y follow path (plus a wrap-around
+  // entry), edge_len[j] is the length of the edge leaving path[j]. The
+  // screen_ arrays are their float copies, shifted to the bounding box
+  // corner, for the single-precision row filter.
+  std::vector<double> city_x, city_y;
+  std::vector<double> tour_x, tour_y, edge_len, row_gains;
+  std::vector<float> screen_x, screen_y, screen_len;
+
+  // Calls body with the compile-time metric of the distances (Metric.h),
+  // so that the loops inside it are specialized for the formula.
+  template <class Body>
+  auto withMetric(Body body) const -> decltype(body(ProviderMetric(nullptr))) {
+    if (dist_matrix != nullptr)
+      return body(MatrixMetric(dist_matrix));
+    switch (distance->getKind()) {
+    case MetricKind::Matrix:
+      return body(MatrixMetric(static_cast<const MatrixDistance*>(distance)->getMatrix()));
+    case MetricKind::Euclidean:
+      return body(static_cast<const MetricDistance<EuclideanFormula>*>(distance)->getMetric());
+    case MetricKind::PseudoEuclidean:
+      return body(static_cast<const MetricDistance<PseudoEuclideanFormula>*>(distance)->getMetric());
+    case MetricKind::Euc2D:
+      return body(static_cast<const MetricDistance<Euc2DFormula>*>(distance)->getMetric());
+    case MetricKind::Ceil2D:
+      return body(static_cast<const MetricDistance<Ceil2DFormula>*>(distance)->getMetric());
+    case MetricKind::Att:
+      return body(static_cast<const MetricDistance<AttFormula>*>(distance)->getMetric());
+    case MetricKind::Geo:
+      return body(static_cast<const MetricDistance<GeoFormula>*>(distance)->getMetric());
+    default:
+      return body(ProviderMetric(distance));
+    }
+  }
+
+  template <class Metric>
+  double twoOptGain(const Metric& metric, long i, long j) const;
+  template <class Metric>
+  double bestTwoOptMove(const Metric& metric, long a, Flip& move);
+  bool candidateLocalSearch();
+  bool parallelLocalSearch();
+  bool simdLocalSearch();
+  void makeOrOptMove(long s1, long s2, long c, long d, bool reversed);
+  template <class Metric>
+  double bestOrOptMove(const Metric& metric, long s1, Flip& move, bool& reversed);
+  template <class Metric>
+  bool improveFromCity(const Metric& metric, long t1, std::vector<Flip>& flips);
+  void activate(long city);
+  template <class Metric>
+  bool improveCity(const Metric& metric, long city, std::vector<Flip>& flips);
+  template <class Metric>
+  bool drainQueue(const Metric& metric);
+  bool drainQueue();
+  bool queueSearch();
+  // Every 2-opt move is appended here while it is set, so that a kick and
+  // its re-optimization can be rolled back.
+  std::vector<Flip>* flip_log = nullptr;
+  double applyKick();
+  bool searchStep();
+  // An empty file name skips saving.
+  void savePath(DataReader* reader, const std::string& file_name);
+  // Gains computed by the searches so far, for benchmarking.
+  long long moves_evaluated = 0;
+  void countEvaluated(long long moves) {
+    moves_evaluated += moves;
+    TSP_COUNT(MovesEvaluated, moves);
+  }
 
 public:
+  enum class Kick { DoubleBridge, SegmentReversal };
+  enum class Acceptance { Better, BetterOrEqual, Threshold };
+
   bool first_step = false;
+  bool use_candidates = false;
+  bool use_or_opt = false;
+  bool use_lin_kernighan = false;
+  long lk_max_depth = 50;
+  bool use_dont_look_bits = false;
+  // Threads for the best-improvement 2-opt sweep of localSearch.
+  long threads = 1;
+  // Vectorized full 2-opt sweep, see setCoordinates.
+  bool use_simd = false;
+  // Tours with at least this many cities are kept in a two-level list
+  // during the candidate searches (O(sqrt(n)) reversals).
+  long two_level_min_size = 50000;
+  // When set, intermediate tours go through this background writer instead
+  // of DataReader::SavePath (not owned).
+  CheckpointWriter* checkpoint = nullptr;
+  // When set, randomNodeStarter and parallelRandomNodeStarter append every
+  // start's final tour here instead of writing a file per start (not
+  // owned).
+  ResultsStore* results = nullptr;
+  // iteratedKickSearch: perturbation, the longest stretch it spans and the
+  // rule for keeping a kicked tour (Threshold keeps tours within
+  // accept_threshold, relative, of the best one).
+  Kick kick = Kick::DoubleBridge;
+  long kick_length = 50;
+  Acceptance acceptance = Acceptance::Better;
+  double accept_threshold = 0.0;
+  // When not empty, kicks start at one of these cities instead of anywhere.
+  std::vector<long> kick_cities;
+  // When set, iteratedKickSearch appends (seconds since the call, cost)
+  // after its first descent and at every new best tour (not owned, not
+  // copied).
+  std::vector<std::pair<double, double>>* best_trace = nullptr;
+  // Random starts and kicks. The multi-starters run start i on
+  // random.split(i), so their results do not depend on the scheduling.
+  Random random;
   long getSize() const;
   long* getPath() const;
   double getPathCost() const;
   double** getDistMatrix() const;
+  const DistanceProvider* getDistance() const;
+  long long getMovesEvaluated() const;
   TSP(double** dist_matrix, double** dist_pseudo_matrix, long node_num);
+  TSP(const DistanceProvider* distance, long node_num);
+  // Copies the search settings, candidate lists and current tour; the
+  // distances are shared.
+  TSP(const TSP& other);
+  TSP& operator=(const TSP&) = delete;
   ~TSP();
 
   void printDecisionPath();
@@ -120,10 +273,40 @@ public:
   double calculatePathCost(long* path, long size, bool pseudo=false);
 
   void createInitialDecision(int start_vertex=-1);
+  // O(n log n) starting tours built over a kd-tree of the coordinates: the
+  // nearest neighbour tour, the greedy edge matching over the k nearest
+  // neighbours, and the Hilbert curve order. Neighbours are chosen by plain
+  // Euclidean distance, the tour cost uses this TSP's distances.
+  void createNearestNeighbourTour(const std::vector<node_info>& data, long start_vertex=-1);
+  void createGreedyEdgeTour(const std::vector<node_info>& data, long k=10);
+  void createSpaceFillingCurveTour(const std::vector<node_info>& data);
+  // Starts from a copy of the given tour.
+  void setPath(const long* path);
   bool localSearch();
+  bool orOptSearch();
+  bool linKernighanSearch();
+  // Don't-look-bit search seeded with the given cities only; the rest of
+  // the tour is looked at when a move changes one of its edges. Needs
+  // candidate lists.
+  bool localSearchAround(const std::vector<long>& cities);
+  // Copy of the tour with path[i..j] reversed. The array belongs to the
+  // workspace and is overwritten by the next call.
   long* TwoOptSwap(long& i, long& j, long size);
+  double twoOptGain(long i, long j) const;
+  void reversePath(long i, long j);
   void iteratedLocalSearch(DataReader* reader, std::string file_name, long interations=-1);
+  void iteratedKickSearch(DataReader* reader, std::string file_name, long kicks, double seconds=-1);
   void randomNodeStarter(DataReader* reader, std::string file_name, std::string dir_name, long node1=-1, long node2=-1, long iterations=-1);
+  void parallelRandomNodeStarter(DataReader* reader, std::string file_name, std::string dir_name, long node1=-1, long node2=-1, long iterations=-1, long threads=0);
   void finBestGreedy(long vertex_num);
+  // Nearest neighbour tours from the first vertex_num cities, spread over
+  // a pool. The kd-tree is built once and every worker reuses its own
+  // set of unvisited cities and tour buffer.
+  void finBestGreedy(long vertex_num, const std::vector<node_info>& data, long threads=0);
+  void buildCandidateLists(const std::vector<node_info>& data, long k = 10);
+  void resetDontLookBits();
+  // Gives the SIMD sweep the city coordinates. Only RAW Euclidean
+  // instances can use it, for other types the call is ignored.
+  void setCoordinates(const std::vector<node_info>& data, EdgeWeightType type = EdgeWeightType::RAW);
 };
 #endif  // INCLUDE_TSPALGORITHM_H_
@@ -0,0 +1,218 @@
+// Copyright 2020 GHA Test Team
+#include "TSPLibReader.h"
+#include "Instrumentation.h"
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+  const char* data = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#endif
+
+public:
+  MappedFile(const std::string& file_name) {
+#ifdef _WIN32
+    file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+      return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+      return;
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data != nullptr)
+      length = (size_t)file_size.QuadPart;
+#else
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address != MAP_FAILED) {
+        data = static_cast<const char*>(address);
+        length = info.st_size;
+        madvise(address, length, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data != nullptr)
+      UnmapViewOfFile(data);
+    if (mapping != nullptr)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#else
+    if (data != nullptr)
+      munmap(const_cast<char*>(data), length);
+#endif
+  }
+
+  bool isOpen() const { return data != nullptr; }
+  const char* begin() const { return data; }
+  const char* end() const { return data + length; }
+};
+
+
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void skipBlanks(const char*& p, const char* end) {
+  while (p < end && isBlank(*p))
+    p++;
+}
+
+// Parses a decimal number at p without allocating. Numbers whose digits
+// fit into 2^53 with at most 22 fraction digits are exact in double
+// arithmetic; the rest go through strtod.
+static bool parseNumber(const char*& p, const char* end, double& value) {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+
+  unsigned long long mantissa = 0;
+  int digits = 0, fraction = 0;
+  bool exact = true;
+  for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+    mantissa = mantissa * 10 + (*p - '0');
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, fraction++)
+      mantissa = mantissa * 10 + (*p - '0');
+  }
+  if (digits == 0) {
+    p = start;
+    return false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E'))
+    exact = false;
+  if (digits > 19 || mantissa > (1ULL << 53) || fraction > 22)
+    exact = false;
+
+  if (exact) {
+    value = (double)mantissa / kPow10[fraction];
+    if (negative)
+      value = -value;
+    return true;
+  }
+
+  char buffer[128];
+  const char* token_end = start;
+  while (token_end < end && !isBlank(*token_end) && token_end - start < 127)
+    token_end++;
+  std::memcpy(buffer, start, token_end - start);
+  buffer[token_end - start] = '\0';
+  char* parsed_end;
+  value = std::strtod(buffer, &parsed_end);
+  p = start + (parsed_end - buffer);
+  return parsed_end != buffer;
+}
+
+static std::string trim(const char* begin, const char* end) {
+  while (begin < end && isBlank(*begin))
+    begin++;
+  while (end > begin && isBlank(end[-1]))
+    end--;
+  return std::string(begin, end);
+}
+
+bool readTSPLib(const std::string& file_name, TSPLibInstance& instance) {
+  TSP_PHASE(Io);
+  MappedFile file(file_name);
+  if (!file.isOpen())
+    return false;
+
+  const char* p = file.begin();
+  const char* end = file.end();
+  instance = TSPLibInstance();
+
+  // Header lines "KEY : VALUE" up to NODE_COORD_SECTION. A bare file
+  // starts with a number right away.
+  skipBlanks(p, end);
+  bool header = p < end && !(*p >= '0' && *p <= '9');
+  if (header)
+    instance.edge_weight_type = EdgeWeightType::EUC_2D;
+  while (header && p < end) {
+    const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (line_end == nullptr)
+      line_end = end;
+    const char* colon = static_cast<const char*>(std::memchr(p, ':', line_end - p));
+    std::string key = trim(p, colon != nullptr ? colon : line_end);
+    std::string value = colon != nullptr ? trim(colon + 1, line_end) : "";
+    p = line_end;
+    skipBlanks(p, end);
+
+    if (key == "NODE_COORD_SECTION")
+      break;
+    if (key == "EOF")
+      return false;
+    if (key == "NAME")
+      instance.name = value;
+    else if (key == "COMMENT")
+      instance.comment += instance.comment.empty() ? value : "\n" + value;
+    else if (key == "DIMENSION")
+      instance.dimension = std::atol(value.c_str());
+    else if (key == "EDGE_WEIGHT_TYPE") {
+      if (value == "EUC_2D")
+        instance.edge_weight_type = EdgeWeightType::EUC_2D;
+      else if (value == "CEIL_2D")
+        instance.edge_weight_type = EdgeWeightType::CEIL_2D;
+      else if (value == "GEO")
+        instance.edge_weight_type = EdgeWeightType::GEO;
+      else if (value == "ATT")
+        instance.edge_weight_type = EdgeWeightType::ATT;
+      else
+        return false;
+    }
+  }
+
+  if (instance.dimension > 0)
+    instance.nodes.reserve(instance.dimension);
+  double id, x, y;
+  while (true) {
+    skipBlanks(p, end);
+    if (!parseNumber(p, end, id))
+      break;
+    skipBlanks(p, end);
+    if (!parseNumber(p, end, x))
+      break;
+    skipBlanks(p, end);
+    if (!parseNumber(p, end, y))
+      break;
+    node_info node;
+    node.id = (long)id;
+    node.x = x;
+    node.y = y;
+    instance.nodes.push_back(node);
+  }
+  if (instance.dimension == 0)
+    instance.dimension = instance.nodes.size();
+  return true;
+}
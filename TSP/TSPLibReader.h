@@ -0,0 +1,22 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_TSPLIBREADER_H_
+#define INCLUDE_TSPLIBREADER_H_
+#include <string>
+#include <vector>
+#include "DistanceProvider.h"
+
+struct TSPLibInstance {
+  std::string name;
+  std::string comment;
+  long dimension = 0;
+  EdgeWeightType edge_weight_type = EdgeWeightType::RAW;
+  std::vector<node_info> nodes;
+};
+
+// Loads a TSPLIB file (NAME/COMMENT/DIMENSION/EDGE_WEIGHT_TYPE headers and
+// a NODE_COORD_SECTION) or a bare "id x y" file, which gets the RAW type.
+// The file is memory-mapped and parsed in place. Returns false when the
+// file cannot be opened or the edge weight type is not supported.
+bool readTSPLib(const std::string& file_name, TSPLibInstance& instance);
+
+#endif  // INCLUDE_TSPLIBREADER_H_
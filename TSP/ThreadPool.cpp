@@ -0,0 +1,98 @@
+// Copyright 2020 GHA Test Team
+#include "ThreadPool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(long threads) : queued(0) {
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  this->threads = threads;
+  for (long i = 0; i < threads; i++)
+    queues.emplace_back(new Queue());
+  for (long i = 0; i < threads; i++)
+    workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers)
+    worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+  long target;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    target = next_queue;
+    next_queue = (next_queue + 1) % getThreads();
+    pending++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[target]->mutex);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued++;
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::parallelFor(long begin, long end, long grain,
+                             const std::function<void(long, long, long)>& body) {
+  if (grain < 1)
+    grain = 1;
+  for (long lo = begin; lo < end; lo += grain) {
+    long hi = std::min(end, lo + grain);
+    submit([&body, lo, hi](long worker) { body(worker, lo, hi); });
+  }
+  wait();
+}
+
+bool ThreadPool::pop(long worker, Task& task) {
+  long threads = getThreads();
+  for (long k = 0; k < threads; k++) {
+    Queue& queue = *queues[(worker + k) % threads];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (k == 0) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    else {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    queued--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run(long worker) {
+  while (true) {
+    Task task;
+    if (pop(worker, task)) {
+      task(worker);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0)
+        done.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0)
+      return;
+  }
+}
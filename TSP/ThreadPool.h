@@ -0,0 +1,56 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_THREADPOOL_H_
+#define INCLUDE_THREADPOOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker takes tasks
+// from the front of its own deque and steals from the back of the others
+// when it runs dry. Tasks get the index of the worker running them, so
+// they can use per-worker state.
+class ThreadPool {
+public:
+  typedef std::function<void(long)> Task;
+
+  // threads <= 0 means one worker per hardware thread.
+  explicit ThreadPool(long threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  long getThreads() const { return threads; }
+  void submit(Task task);
+  // Blocks until every submitted task has finished.
+  void wait();
+  // Splits [begin, end) into chunks of at most grain indices and runs
+  // body(worker, lo, hi) on them, then waits.
+  void parallelFor(long begin, long end, long grain,
+                   const std::function<void(long, long, long)>& body);
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  long threads;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::atomic<long> queued;
+  long pending = 0;
+  long next_queue = 0;
+  bool stopping = false;
+
+  bool pop(long worker, Task& task);
+  void run(long worker);
+};
+
+#endif  // INCLUDE_THREADPOOL_H_
@@ -0,0 +1,23 @@
+// Copyright 2020 GHA Test Team
+#include "TourWorkspace.h"
+#include <algorithm>
+
+char* TourWorkspace::visited() {
+  char* flags = get(visited_flags);
+  std::fill(flags, flags + size, 0);
+  return flags;
+}
+
+void TourWorkspace::push(long city) {
+  long* cities = get(queue);
+  long tail = head + count;
+  cities[tail >= size ? tail - size : tail] = city;
+  count++;
+}
+
+long TourWorkspace::pop() {
+  long city = queue[head];
+  head = head + 1 == size ? 0 : head + 1;
+  count--;
+  return city;
+}
@@ -0,0 +1,72 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_TOURWORKSPACE_H_
+#define INCLUDE_TOURWORKSPACE_H_
+#include <vector>
+
+struct Change {
+  double cost;
+  long node1;
+  long node2;
+};
+
+
+// A 2-opt move that replaced the tour edges (a, b) and (c, d) by (a, c)
+// and (b, d).
+struct Flip {
+  long a, b, c, d;
+};
+
+
+// Every buffer a TSP search needs for tours of one size: the tour itself,
+// the best tours of the multi-starts and of the kick search, the city
+// positions, the construction and don't-look-bit flags with their queue,
+// and the move logs. A buffer is allocated the first time it is asked for
+// and then reused, so repeated starts on the same instance do not touch
+// the heap. Every TSP owns one; the parallel starters give each worker its
+// own TSP copy and so its own workspace.
+class TourWorkspace {
+public:
+  explicit TourWorkspace(long size = 0) : size(size) {}
+  TourWorkspace(const TourWorkspace&) = delete;
+  TourWorkspace& operator=(const TourWorkspace&) = delete;
+
+  long getSize() const { return size; }
+
+  long* path() { return get(tour); }
+  long* bestStartPath() { return get(best_start); }
+  long* bestKickPath() { return get(best_kick); }
+  long* swapPath() { return get(swapped); }
+  long* position() { return get(positions); }
+  // Cleared on every call.
+  char* visited();
+  char* queued() { return get(queued_flags); }
+
+  // FIFO of cities for the don't-look-bit search. Holds up to size cities,
+  // enough since a city is queued at most once.
+  void clearQueue() { head = count = 0; }
+  bool queueEmpty() const { return count == 0; }
+  void push(long city);
+  long pop();
+
+  // Moves of one Lin-Kernighan step, moves since the last kick, and the
+  // per-worker bests of the parallel 2-opt sweep.
+  std::vector<Flip> flips;
+  std::vector<Flip> log;
+  std::vector<Change> changes;
+
+private:
+  long size;
+  std::vector<long> tour, best_start, best_kick, swapped, positions;
+  std::vector<char> visited_flags, queued_flags;
+  std::vector<long> queue;
+  long head = 0, count = 0;
+
+  template <class T>
+  T* get(std::vector<T>& buffer) {
+    if ((long)buffer.size() != size)
+      buffer.assign(size, T());
+    return buffer.data();
+  }
+};
+
+#endif  // INCLUDE_TOURWORKSPACE_H_
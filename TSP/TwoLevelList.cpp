@@ -0,0 +1,182 @@
+// Copyright 2020 GHA Test Team
+#include "TwoLevelList.h"
+#include "Instrumentation.h"
+#include <algorithm>
+#include <cmath>
+
+
+TwoLevelList::TwoLevelList(const long* path, long size, long group_size) {
+  this->size = size;
+  if (group_size <= 0)
+    group_size = std::max(8L, (long)std::sqrt((double)size));
+  this->group_size = group_size;
+  city_segment.resize(size);
+  city_index.resize(size);
+  assign(path);
+}
+
+void TwoLevelList::assign(const long* path) {
+  segments.clear();
+  order.clear();
+  offset.clear();
+  for (long begin = 0; begin < size; begin += group_size) {
+    long end = std::min(size, begin + group_size);
+    Segment segment;
+    segment.cities.assign(path + begin, path + end);
+    segment.reversed = false;
+    segment.rank = order.size();
+    for (long k = 0; k < end - begin; k++) {
+      city_segment[path[begin + k]] = segments.size();
+      city_index[path[begin + k]] = k;
+    }
+    order.push_back(segments.size());
+    offset.push_back(begin);
+    segments.push_back(std::move(segment));
+  }
+}
+
+long TwoLevelList::orientedIndex(long city) const {
+  const Segment& segment = segments[city_segment[city]];
+  long index = city_index[city];
+  return segment.reversed ? (long)segment.cities.size() - 1 - index : index;
+}
+
+long TwoLevelList::cityAt(const Segment& segment, long oriented) const {
+  return segment.reversed ? segment.cities[segment.cities.size() - 1 - oriented] : segment.cities[oriented];
+}
+
+long TwoLevelList::position(long city) const {
+  return (offset[segments[city_segment[city]].rank] + orientedIndex(city)) % size;
+}
+
+long TwoLevelList::next(long city) const {
+  const Segment& segment = segments[city_segment[city]];
+  long oriented = orientedIndex(city);
+  if (oriented + 1 < (long)segment.cities.size())
+    return cityAt(segment, oriented + 1);
+  const Segment& following = segments[order[(segment.rank + 1) % order.size()]];
+  return cityAt(following, 0);
+}
+
+long TwoLevelList::prev(long city) const {
+  const Segment& segment = segments[city_segment[city]];
+  long oriented = orientedIndex(city);
+  if (oriented > 0)
+    return cityAt(segment, oriented - 1);
+  const Segment& preceding = segments[order[(segment.rank + order.size() - 1) % order.size()]];
+  return cityAt(preceding, preceding.cities.size() - 1);
+}
+
+bool TwoLevelList::between(long a, long b, long c) const {
+  long pa = position(a), pb = position(b), pc = position(c);
+  if (pa <= pc)
+    return pa <= pb && pb <= pc;
+  return pb >= pa || pb <= pc;
+}
+
+// Cuts the segment `id` before its oriented index `oriented`; the tail
+// becomes a new segment right after it in the tour.
+void TwoLevelList::split(long id, long oriented) {
+  Segment tail;
+  {
+    Segment& head = segments[id];
+    std::vector<long> cities(head.cities.size());
+    for (size_t k = 0; k < cities.size(); k++)
+      cities[k] = cityAt(head, k);
+    head.cities.assign(cities.begin(), cities.begin() + oriented);
+    head.reversed = false;
+    tail.cities.assign(cities.begin() + oriented, cities.end());
+    tail.reversed = false;
+    tail.rank = head.rank + 1;
+    for (long k = 0; k < oriented; k++)
+      city_index[head.cities[k]] = k;
+  }
+
+  long tail_id = segments.size();
+  for (size_t k = 0; k < tail.cities.size(); k++) {
+    city_segment[tail.cities[k]] = tail_id;
+    city_index[tail.cities[k]] = k;
+  }
+  order.insert(order.begin() + tail.rank, tail_id);
+  offset.insert(offset.begin() + tail.rank, (offset[tail.rank - 1] + oriented) % size);
+  segments.push_back(std::move(tail));
+  for (size_t r = segments[tail_id].rank; r < order.size(); r++)
+    segments[order[r]].rank = r;
+}
+
+// Reverses from..to when both lie in one segment with from before to.
+void TwoLevelList::reverseInside(long from, long to) {
+  Segment& segment = segments[city_segment[from]];
+  long i = city_index[from], j = city_index[to];
+  if (i > j)
+    std::swap(i, j);
+  while (i < j) {
+    std::swap(segment.cities[i], segment.cities[j]);
+    city_index[segment.cities[i]] = i;
+    city_index[segment.cities[j]] = j;
+    i++;
+    j--;
+  }
+}
+
+void TwoLevelList::reverse(long from, long to) {
+  long len = (position(to) - position(from) + size) % size + 1;
+  if (len == size || from == to)
+    return;
+  // Reversing the complement gives the same cycle; take the shorter one.
+  if (2 * len > size) {
+    long new_from = next(to), new_to = prev(from);
+    from = new_from;
+    to = new_to;
+    len = size - len;
+  }
+  TSP_COUNT(Reversals, 1);
+  TSP_COUNT(ReversalLength, len);
+
+  if (city_segment[from] == city_segment[to] && orientedIndex(from) <= orientedIndex(to)) {
+    reverseInside(from, to);
+    return;
+  }
+
+  if (orientedIndex(from) > 0)
+    split(city_segment[from], orientedIndex(from));
+  if (orientedIndex(to) + 1 < (long)segments[city_segment[to]].cities.size())
+    split(city_segment[to], orientedIndex(to) + 1);
+
+  // Reverse the run of whole segments from..to in the cyclic order.
+  long m = order.size();
+  long first = segments[city_segment[from]].rank, last = segments[city_segment[to]].rank;
+  long count = (last - first + m) % m + 1;
+  for (long k = 0; k < count / 2; k++) {
+    long r1 = (first + k) % m, r2 = (last - k + m) % m;
+    std::swap(order[r1], order[r2]);
+  }
+  // The run still starts at the same tour position; only the offsets
+  // inside it change.
+  long start = offset[first];
+  for (long k = 0; k < count; k++) {
+    long r = (first + k) % m;
+    Segment& segment = segments[order[r]];
+    segment.rank = r;
+    segment.reversed = !segment.reversed;
+    offset[r] = start;
+    start = (start + segment.cities.size()) % size;
+  }
+
+  // Every reversal adds at most two segments; rebuild once they have
+  // doubled so next/prev stay cheap.
+  if (m > 2 * (size / group_size + 1)) {
+    std::vector<long> path(size);
+    toArray(path.data());
+    assign(path.data());
+  }
+}
+
+void TwoLevelList::toArray(long* path) const {
+  long k = 0;
+  for (long id : order) {
+    const Segment& segment = segments[id];
+    for (size_t o = 0; o < segment.cities.size(); o++)
+      path[k++] = cityAt(segment, o);
+  }
+}
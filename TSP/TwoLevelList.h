@@ -0,0 +1,52 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_TWOLEVELLIST_H_
+#define INCLUDE_TWOLEVELLIST_H_
+#include <vector>
+
+// Two-level tour representation: the tour is cut into about sqrt(n)
+// segments, each a small array with a reversed bit, kept in a cyclic order
+// of segments. next/prev/between are O(1): every segment keeps its rank
+// and tour offset, which reverse updates along with the segments it
+// touches. Reversing a stretch of the tour splits at most two segments and
+// reverses the order of the segments in between, so it costs O(sqrt(n))
+// instead of O(n).
+class TwoLevelList {
+private:
+  struct Segment {
+    std::vector<long> cities;
+    bool reversed;
+    long rank;
+  };
+  long size;
+  long group_size;
+  std::vector<Segment> segments;
+  // Segment ids in tour order; segments[order[r]].rank == r.
+  std::vector<long> order;
+  std::vector<long> city_segment;
+  std::vector<long> city_index;
+  // Tour position of the first city of the segment with rank r, modulo
+  // size and up to a rotation of the whole tour, which between and the
+  // reversal lengths do not see. Kept up to date by split and reverse.
+  std::vector<long> offset;
+
+  long orientedIndex(long city) const;
+  long cityAt(const Segment& segment, long oriented) const;
+  long position(long city) const;
+  void split(long id, long oriented);
+  void reverseInside(long from, long to);
+
+public:
+  TwoLevelList(const long* path, long size, long group_size = 0);
+
+  void assign(const long* path);
+  long getSize() const { return size; }
+  long next(long city) const;
+  long prev(long city) const;
+  // True when b lies on the forward path from a to c (ends included).
+  bool between(long a, long b, long c) const;
+  // Reverses the forward path from city `from` to city `to`.
+  void reverse(long from, long to);
+  void toArray(long* path) const;
+};
+
+#endif  // INCLUDE_TWOLEVELLIST_H_
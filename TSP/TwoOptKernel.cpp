@@ -0,0 +1,186 @@
+// Copyright 2020 GHA Test Team
+#include "TwoOptKernel.h"
+#include <cmath>
+#include <limits>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define TWO_OPT_KERNEL_X86
+// AVX-512F (and AVX2 on GCC) targets would otherwise fuse a*a + b*b into an
+// FMA and round the gains differently from the scalar sweep.
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+double rowScalar(const double* tour_x, const double* tour_y, const double* edge_len,
+                 double ax, double ay, double bx, double by, double ab,
+                 long lo, long hi, double* gains) {
+  double best = -std::numeric_limits<double>::infinity();
+  for (long j = lo; j < hi; j++) {
+    double acx = tour_x[j] - ax, acy = tour_y[j] - ay;
+    double bdx = tour_x[j + 1] - bx, bdy = tour_y[j + 1] - by;
+    double gain = ab + edge_len[j] - std::sqrt(acx * acx + acy * acy) - std::sqrt(bdx * bdx + bdy * bdy);
+    gains[j] = gain;
+    if (gain > best)
+      best = gain;
+  }
+  return best;
+}
+
+#ifdef TWO_OPT_KERNEL_X86
+__attribute__((target("avx2")))
+double rowAVX2(const double* tour_x, const double* tour_y, const double* edge_len,
+               double ax, double ay, double bx, double by, double ab,
+               long lo, long hi, double* gains) {
+  __m256d vax = _mm256_set1_pd(ax), vay = _mm256_set1_pd(ay);
+  __m256d vbx = _mm256_set1_pd(bx), vby = _mm256_set1_pd(by);
+  __m256d vab = _mm256_set1_pd(ab);
+  __m256d vbest = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+  long j = lo;
+  for (; j + 4 <= hi; j += 4) {
+    __m256d acx = _mm256_sub_pd(_mm256_loadu_pd(tour_x + j), vax);
+    __m256d acy = _mm256_sub_pd(_mm256_loadu_pd(tour_y + j), vay);
+    __m256d bdx = _mm256_sub_pd(_mm256_loadu_pd(tour_x + j + 1), vbx);
+    __m256d bdy = _mm256_sub_pd(_mm256_loadu_pd(tour_y + j + 1), vby);
+    __m256d ac = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(acx, acx), _mm256_mul_pd(acy, acy)));
+    __m256d bd = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(bdx, bdx), _mm256_mul_pd(bdy, bdy)));
+    __m256d gain = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(vab, _mm256_loadu_pd(edge_len + j)), ac), bd);
+    _mm256_storeu_pd(gains + j, gain);
+    vbest = _mm256_max_pd(vbest, gain);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, vbest);
+  double best = rowScalar(tour_x, tour_y, edge_len, ax, ay, bx, by, ab, j, hi, gains);
+  for (double lane : lanes)
+    if (lane > best)
+      best = lane;
+  return best;
+}
+
+__attribute__((target("avx512f")))
+double rowAVX512(const double* tour_x, const double* tour_y, const double* edge_len,
+                 double ax, double ay, double bx, double by, double ab,
+                 long lo, long hi, double* gains) {
+  __m512d vax = _mm512_set1_pd(ax), vay = _mm512_set1_pd(ay);
+  __m512d vbx = _mm512_set1_pd(bx), vby = _mm512_set1_pd(by);
+  __m512d vab = _mm512_set1_pd(ab);
+  __m512d vbest = _mm512_set1_pd(-std::numeric_limits<double>::infinity());
+  // The tail runs masked; the zero-masked forms also keep GCC from seeing
+  // the undefined pass-through of the unmasked sqrt and max intrinsics.
+  for (long j = lo; j < hi; j += 8) {
+    __mmask8 mask = hi - j >= 8 ? 0xFF : (__mmask8)((1u << (hi - j)) - 1);
+    __m512d acx = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, tour_x + j), vax);
+    __m512d acy = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, tour_y + j), vay);
+    __m512d bdx = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, tour_x + j + 1), vbx);
+    __m512d bdy = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, tour_y + j + 1), vby);
+    __m512d ac = _mm512_maskz_sqrt_pd(mask, _mm512_add_pd(_mm512_mul_pd(acx, acx), _mm512_mul_pd(acy, acy)));
+    __m512d bd = _mm512_maskz_sqrt_pd(mask, _mm512_add_pd(_mm512_mul_pd(bdx, bdx), _mm512_mul_pd(bdy, bdy)));
+    __m512d len = _mm512_maskz_loadu_pd(mask, edge_len + j);
+    __m512d gain = _mm512_sub_pd(_mm512_sub_pd(_mm512_add_pd(vab, len), ac), bd);
+    _mm512_mask_storeu_pd(gains + j, mask, gain);
+    vbest = _mm512_mask_max_pd(vbest, mask, vbest, gain);
+  }
+  double lanes[8];
+  _mm512_storeu_pd(lanes, vbest);
+  double best = lanes[0];
+  for (double lane : lanes)
+    if (lane > best)
+      best = lane;
+  return best;
+}
+
+float screenScalar(const float* tour_x, const float* tour_y, const float* edge_len,
+                   float ax, float ay, float bx, float by, float ab,
+                   long lo, long hi) {
+  float best = -std::numeric_limits<float>::infinity();
+  for (long j = lo; j < hi; j++) {
+    float acx = tour_x[j] - ax, acy = tour_y[j] - ay;
+    float bdx = tour_x[j + 1] - bx, bdy = tour_y[j + 1] - by;
+    float gain = ab + edge_len[j] - std::sqrt(acx * acx + acy * acy) - std::sqrt(bdx * bdx + bdy * bdy);
+    if (gain > best)
+      best = gain;
+  }
+  return best;
+}
+
+__attribute__((target("avx2")))
+float screenAVX2(const float* tour_x, const float* tour_y, const float* edge_len,
+                 float ax, float ay, float bx, float by, float ab,
+                 long lo, long hi) {
+  __m256 vax = _mm256_set1_ps(ax), vay = _mm256_set1_ps(ay);
+  __m256 vbx = _mm256_set1_ps(bx), vby = _mm256_set1_ps(by);
+  __m256 vab = _mm256_set1_ps(ab);
+  __m256 vbest = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  long j = lo;
+  for (; j + 8 <= hi; j += 8) {
+    __m256 acx = _mm256_sub_ps(_mm256_loadu_ps(tour_x + j), vax);
+    __m256 acy = _mm256_sub_ps(_mm256_loadu_ps(tour_y + j), vay);
+    __m256 bdx = _mm256_sub_ps(_mm256_loadu_ps(tour_x + j + 1), vbx);
+    __m256 bdy = _mm256_sub_ps(_mm256_loadu_ps(tour_y + j + 1), vby);
+    __m256 ac = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(acx, acx), _mm256_mul_ps(acy, acy)));
+    __m256 bd = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(bdx, bdx), _mm256_mul_ps(bdy, bdy)));
+    __m256 gain = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(vab, _mm256_loadu_ps(edge_len + j)), ac), bd);
+    vbest = _mm256_max_ps(vbest, gain);
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, vbest);
+  float best = screenScalar(tour_x, tour_y, edge_len, ax, ay, bx, by, ab, j, hi);
+  for (float lane : lanes)
+    if (lane > best)
+      best = lane;
+  return best;
+}
+
+__attribute__((target("avx512f")))
+float screenAVX512(const float* tour_x, const float* tour_y, const float* edge_len,
+                   float ax, float ay, float bx, float by, float ab,
+                   long lo, long hi) {
+  __m512 vax = _mm512_set1_ps(ax), vay = _mm512_set1_ps(ay);
+  __m512 vbx = _mm512_set1_ps(bx), vby = _mm512_set1_ps(by);
+  __m512 vab = _mm512_set1_ps(ab);
+  __m512 vbest = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+  for (long j = lo; j < hi; j += 16) {
+    __mmask16 mask = hi - j >= 16 ? 0xFFFF : (__mmask16)((1u << (hi - j)) - 1);
+    __m512 acx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, tour_x + j), vax);
+    __m512 acy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, tour_y + j), vay);
+    __m512 bdx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, tour_x + j + 1), vbx);
+    __m512 bdy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, tour_y + j + 1), vby);
+    __m512 ac = _mm512_maskz_sqrt_ps(mask, _mm512_add_ps(_mm512_mul_ps(acx, acx), _mm512_mul_ps(acy, acy)));
+    __m512 bd = _mm512_maskz_sqrt_ps(mask, _mm512_add_ps(_mm512_mul_ps(bdx, bdx), _mm512_mul_ps(bdy, bdy)));
+    __m512 len = _mm512_maskz_loadu_ps(mask, edge_len + j);
+    __m512 gain = _mm512_sub_ps(_mm512_sub_ps(_mm512_add_ps(vab, len), ac), bd);
+    vbest = _mm512_mask_max_ps(vbest, mask, vbest, gain);
+  }
+  float lanes[16];
+  _mm512_storeu_ps(lanes, vbest);
+  float best = lanes[0];
+  for (float lane : lanes)
+    if (lane > best)
+      best = lane;
+  return best;
+}
+#endif
+
+}  // namespace
+
+TwoOptRowKernel selectTwoOptKernel() {
+#ifdef TWO_OPT_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return rowAVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return rowAVX2;
+#endif
+  return rowScalar;
+}
+
+TwoOptScreenKernel selectTwoOptScreenKernel() {
+#ifdef TWO_OPT_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return screenAVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return screenAVX2;
+#endif
+  return nullptr;
+}
@@ -0,0 +1,35 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_TWOOPTKERNEL_H_
+#define INCLUDE_TWOOPTKERNEL_H_
+
+// Gains of the 2-opt moves (i, j) for a fixed i and j in [lo, hi), where
+// reversing path[i..j] replaces the edges (a, b) and (c_j, d_j) by (a, c_j)
+// and (b, d_j). tour_x/tour_y hold the coordinates of path in tour order
+// plus one wrap-around entry, edge_len[j] is the length of (c_j, d_j) and
+// ab the length of (a, b). Gains are written to gains[j] with the same
+// rounding as the scalar dist(a, b) + dist(c, d) - dist(a, c) - dist(b, d);
+// the maximum gain of the range is returned.
+typedef double (*TwoOptRowKernel)(const double* tour_x, const double* tour_y,
+                                  const double* edge_len, double ax, double ay,
+                                  double bx, double by, double ab,
+                                  long lo, long hi, double* gains);
+
+// Widest kernel supported by the running CPU: AVX-512 (8 lanes), AVX2
+// (4 lanes) or scalar.
+TwoOptRowKernel selectTwoOptKernel();
+
+// The maximum gain of the same range in single precision, 16 (AVX-512) or
+// 8 (AVX2) lanes at a time, without writing the gains. It is only a filter:
+// float gains are off by a few float epsilons of the coordinate extent,
+// too much to pick moves by, so a row whose float maximum comes within
+// that error of the best move is rerun through the double kernel.
+typedef float (*TwoOptScreenKernel)(const float* tour_x, const float* tour_y,
+                                    const float* edge_len, float ax, float ay,
+                                    float bx, float by, float ab,
+                                    long lo, long hi);
+
+// nullptr when the CPU has neither AVX-512 nor AVX2; a scalar float pass
+// would cost as much as the double one it is meant to save.
+TwoOptScreenKernel selectTwoOptScreenKernel();
+
+#endif  // INCLUDE_TWOOPTKERNEL_H_
@@ -0,0 +1,593 @@
+// Copyright 2020 GHA Test Team
+#include "VRPTabu.h"
+#include "Instrumentation.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+// Time warp and overload below this count as none.
+static const double kFeasibleEps = 1e-6;
+static const double kMinPenalty = 1e-2;
+static const double kMaxPenalty = 1e4;
+
+bool readVRPTW(const std::string& file_name, VRPInstance& instance) {
+  TSP_PHASE(Io);
+  std::ifstream in(file_name);
+  if (!in.is_open())
+    return false;
+
+  instance = VRPInstance();
+  long customers;
+  if (!(in >> customers >> instance.vehicles >> instance.capacity))
+    return false;
+  instance.customers.reserve(customers + 1);
+  VRPCustomer customer;
+  while (in >> customer.id >> customer.x >> customer.y >> customer.demand >> customer.ready >>
+         customer.due >> customer.service)
+    instance.customers.push_back(customer);
+  return !instance.customers.empty();
+}
+
+
+void TabuTable::clear() {
+  slots.clear();
+  used = 0;
+  bits = 0;
+}
+
+unsigned long long TabuTable::edgeKey(long a, long b) {
+  if (a > b)
+    std::swap(a, b);
+  // Never 0, which marks an empty slot.
+  return ((unsigned long long)(a + 1) << 32) | (unsigned long long)(b + 1);
+}
+
+size_t TabuTable::home(unsigned long long key) const {
+  return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// Keeps only the live entries.
+void TabuTable::rehash(int new_bits, long iteration) {
+  std::vector<Slot> old;
+  old.swap(slots);
+  bits = new_bits;
+  slots.assign((size_t)1 << bits, Slot{0, 0});
+  used = 0;
+  size_t mask = slots.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.key == 0 || slot.expiry <= iteration)
+      continue;
+    size_t s = home(slot.key);
+    while (slots[s].key != 0)
+      s = (s + 1) & mask;
+    slots[s] = slot;
+    used++;
+  }
+}
+
+void TabuTable::add(long a, long b, long expiry, long iteration) {
+  if (slots.empty())
+    rehash(10, iteration);
+  unsigned long long key = edgeKey(a, b);
+  size_t mask = slots.size() - 1;
+  size_t s = home(key);
+  size_t reuse = slots.size();
+  for (; slots[s].key != 0; s = (s + 1) & mask) {
+    if (slots[s].key == key) {
+      slots[s].expiry = std::max(slots[s].expiry, expiry);
+      return;
+    }
+    if (reuse == slots.size() && slots[s].expiry <= iteration)
+      reuse = s;
+  }
+  if (reuse != slots.size()) {
+    slots[reuse] = Slot{key, expiry};
+    return;
+  }
+  slots[s] = Slot{key, expiry};
+  if (++used * 2 > (long)slots.size())
+    rehash(bits + 1, iteration);
+}
+
+bool TabuTable::isTabu(long a, long b, long iteration) const {
+  if (slots.empty())
+    return false;
+  unsigned long long key = edgeKey(a, b);
+  size_t mask = slots.size() - 1;
+  for (size_t s = home(key); slots[s].key != 0; s = (s + 1) & mask)
+    if (slots[s].key == key)
+      return slots[s].expiry > iteration;
+  return false;
+}
+
+
+struct VRPTabuSearch::Worker {
+  Move best;
+  long long order;
+  long evaluated;
+};
+
+VRPTabuSearch::VRPTabuSearch(const VRPInstance& instance)
+  : instance(instance), size(instance.customers.size()) {
+  const std::vector<VRPCustomer>& customers = instance.customers;
+  dist.resize(size * size);
+  for (long a = 0; a < size; a++)
+    for (long b = 0; b < size; b++) {
+      double dx = customers[a].x - customers[b].x, dy = customers[a].y - customers[b].y;
+      dist[a * size + b] = std::sqrt(dx * dx + dy * dy);
+    }
+
+  units.resize(size);
+  for (long c = 0; c < size; c++) {
+    const VRPCustomer& customer = customers[c];
+    units[c] = Segment{c, c, 0.0, customer.service, 0.0, customer.ready, customer.due,
+                       c == 0 ? 0.0 : customer.demand};
+    if (c != 0)
+      service_total += customer.service;
+  }
+
+  route_of.assign(size, -1);
+  position_of.assign(size, -1);
+  best_distance = std::numeric_limits<double>::infinity();
+}
+
+VRPTabuSearch::~VRPTabuSearch() {}
+
+// Builds what depends on the parameters; called by the first run().
+void VRPTabuSearch::setup() {
+  // The nearest customers of every customer; the depot is handled apart.
+  k = std::max(0L, std::min(candidates, size - 2));
+  neighbours.resize(size * k);
+  std::vector<long> order;
+  for (long u = 1; u < size; u++) {
+    order.clear();
+    for (long v = 1; v < size; v++)
+      if (v != u)
+        order.push_back(v);
+    std::partial_sort(order.begin(), order.begin() + k, order.end(),
+                      [&](long a, long b) { return distance(u, a) < distance(u, b); });
+    std::copy(order.begin(), order.begin() + k, neighbours.begin() + u * k);
+  }
+
+  pool.reset(new ThreadPool(threads));
+  for (long w = 0; w < pool->getThreads(); w++)
+    workers.emplace_back(new Worker());
+}
+
+// Concatenation of two sequences, travelling from a's last node to b's
+// first: waiting when b would start before its earliest start, time warp
+// (going back in time to the latest start) when it would start after it.
+VRPTabuSearch::Segment VRPTabuSearch::join(const Segment& a, const Segment& b) const {
+  double travel = distance(a.last, b.first);
+  double shift = a.duration - a.time_warp + travel;
+  double wait = std::max(b.earliest - shift - a.latest, 0.0);
+  double warp = std::max(a.earliest + shift - b.latest, 0.0);
+  Segment s;
+  s.first = a.first;
+  s.last = b.last;
+  s.distance = a.distance + b.distance + travel;
+  s.duration = a.duration + b.duration + travel + wait;
+  s.time_warp = a.time_warp + b.time_warp + warp;
+  s.earliest = std::max(b.earliest - shift, a.earliest) - wait;
+  s.latest = std::min(b.latest - shift, a.latest) + warp;
+  s.load = a.load + b.load;
+  return s;
+}
+
+void VRPTabuSearch::rebuild(long r) {
+  Route& route = routes[r];
+  long length = route.nodes.size();
+  route.segments.resize(length * length);
+  for (long i = 0; i < length; i++) {
+    Segment* row = route.segments.data() + i * length;
+    row[i] = units[route.nodes[i]];
+    for (long j = i + 1; j < length; j++)
+      row[j] = join(row[j - 1], units[route.nodes[j]]);
+  }
+  for (long i = 1; i + 1 < length; i++) {
+    route_of[route.nodes[i]] = r;
+    position_of[route.nodes[i]] = i;
+  }
+}
+
+void VRPTabuSearch::updateTotals() {
+  total_distance = total_warp = total_overload = 0.0;
+  first_empty = -1;
+  for (long r = 0; r < (long)routes.size(); r++) {
+    const Segment& s = whole(r);
+    total_distance += s.distance;
+    total_warp += s.time_warp;
+    total_overload += overload(s);
+    if (first_empty == -1 && routes[r].nodes.size() == 2)
+      first_empty = r;
+  }
+}
+
+bool VRPTabuSearch::isCurrentFeasible() const {
+  return !routes.empty() && total_warp <= kFeasibleEps && total_overload <= kFeasibleEps;
+}
+
+double VRPTabuSearch::getCurrentCost() const {
+  return total_distance + service_total;
+}
+
+double VRPTabuSearch::getBestCost() const {
+  return best_distance + service_total;
+}
+
+void VRPTabuSearch::recordBest() {
+  if (!isCurrentFeasible() || total_distance >= best_distance - kFeasibleEps)
+    return;
+  best_distance = total_distance;
+  best_routes.clear();
+  for (const Route& route : routes)
+    if (route.nodes.size() > 2)
+      best_routes.push_back(route.nodes);
+}
+
+// Pads with empty routes up to the number of vehicles.
+void VRPTabuSearch::setRoutes(const std::vector<std::vector<long>>& new_routes) {
+  long count = std::max((long)new_routes.size(), std::max(instance.vehicles, 1L));
+  routes.assign(count, Route());
+  for (long r = 0; r < count; r++) {
+    if (r < (long)new_routes.size())
+      routes[r].nodes = new_routes[r];
+    else
+      routes[r].nodes = {0, 0};
+    rebuild(r);
+  }
+  updateTotals();
+  tabu.clear();
+  best_routes.clear();
+  best_distance = std::numeric_limits<double>::infinity();
+  recordBest();
+}
+
+void VRPTabuSearch::createGreedyRoutes() {
+  TSP_PHASE(Construction);
+  const std::vector<VRPCustomer>& customers = instance.customers;
+  const VRPCustomer& depot = customers[0];
+  std::vector<bool> visited(size, false);
+  visited[0] = true;
+  long left = size - 1;
+  std::vector<std::vector<long>> result;
+
+  long vehicles = std::max(instance.vehicles, 1L);
+  for (long vehicle = 0; vehicle < vehicles && left > 0; vehicle++) {
+    std::vector<long> route(1, 0);
+    long city = 0;
+    double time = depot.ready, load = 0.0;
+    while (true) {
+      long next = -1;
+      double next_start = 0.0;
+      for (long c = 1; c < size; c++) {
+        if (visited[c])
+          continue;
+        const VRPCustomer& customer = customers[c];
+        double start = std::max(time + distance(city, c), customer.ready);
+        if (start > customer.due || load + customer.demand > instance.capacity)
+          continue;
+        if (start + customer.service + distance(c, 0) > depot.due)
+          continue;
+        if (next == -1 || start < next_start) {
+          next = c;
+          next_start = start;
+        }
+      }
+      if (next == -1)
+        break;
+      visited[next] = true;
+      left--;
+      route.push_back(next);
+      time = next_start + customers[next].service;
+      load += customers[next].demand;
+      city = next;
+    }
+    route.push_back(0);
+    result.push_back(route);
+  }
+
+  if (left > 0) {
+    std::vector<long>& route = result.back();
+    route.pop_back();
+    long city = route.back();
+    for (; left > 0; left--) {
+      long next = -1;
+      for (long c = 1; c < size; c++)
+        if (!visited[c] && (next == -1 || distance(city, c) < distance(city, next)))
+          next = c;
+      visited[next] = true;
+      route.push_back(next);
+      city = next;
+    }
+    route.push_back(0);
+  }
+  setRoutes(result);
+}
+
+bool VRPTabuSearch::loadRoutes(const std::string& file_name) {
+  std::ifstream in(file_name);
+  if (!in.is_open())
+    return false;
+  std::map<long, long> index;
+  for (long c = 0; c < size; c++)
+    index[instance.customers[c].id] = c;
+
+  std::vector<std::vector<long>> result;
+  std::vector<bool> visited(size, false);
+  long count = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream fields(line);
+    std::vector<long> route;
+    long id;
+    while (fields >> id) {
+      auto found = index.find(id);
+      if (found == index.end())
+        return false;
+      route.push_back(found->second);
+    }
+    if (route.empty())
+      continue;
+    if (route.size() < 2 || route.front() != 0 || route.back() != 0)
+      return false;
+    for (size_t i = 1; i + 1 < route.size(); i++) {
+      if (route[i] == 0 || visited[route[i]])
+        return false;
+      visited[route[i]] = true;
+      count++;
+    }
+    result.push_back(route);
+  }
+  if (count != size - 1)
+    return false;
+  setRoutes(result);
+  return true;
+}
+
+bool VRPTabuSearch::saveRoutes(const std::string& file_name) const {
+  if (best_routes.empty())
+    return false;
+  std::ofstream out(file_name);
+  if (!out.is_open())
+    return false;
+  for (const std::vector<long>& route : best_routes) {
+    for (size_t i = 0; i < route.size(); i++)
+      out << (i == 0 ? "" : ", ") << instance.customers[route[i]].id;
+    out << std::endl;
+  }
+  return true;
+}
+
+
+// Scores a move from the routes it replaces and the ones it creates, and
+// keeps it when it beats the worker's best admissible move. A move that
+// adds a tabu edge is admissible only when it gives a new best feasible
+// solution.
+void VRPTabuSearch::consider(Worker& worker, Move& move, const Segment* before,
+                             const Segment* after, long count, const long* added,
+                             long added_count) const {
+  worker.evaluated++;
+  move.order = worker.order++;
+  move.delta = move.distance_delta = move.warp_delta = move.overload_delta = 0.0;
+  for (long c = 0; c < count; c++) {
+    move.delta += penalized(after[c]) - penalized(before[c]);
+    move.distance_delta += after[c].distance - before[c].distance;
+    move.warp_delta += after[c].time_warp - before[c].time_warp;
+    move.overload_delta += overload(after[c]) - overload(before[c]);
+  }
+  const Move& best = worker.best;
+  if (best.type != None &&
+      (move.delta > best.delta || (move.delta == best.delta && move.order > best.order)))
+    return;
+
+  for (long e = 0; e < added_count; e += 2) {
+    if (!tabu.isTabu(added[e], added[e + 1], iteration))
+      continue;
+    bool feasible = total_warp + move.warp_delta <= kFeasibleEps &&
+                    total_overload + move.overload_delta <= kFeasibleEps;
+    if (!feasible || total_distance + move.distance_delta >= best_distance - kFeasibleEps)
+      return;
+    break;
+  }
+  worker.best = move;
+}
+
+void VRPTabuSearch::evaluateRelocate(Worker& worker, long r1, long i, long r2, long j) const {
+  if (r1 == r2 && (j == i || j == i - 1))
+    return;
+  const std::vector<long>& a = routes[r1].nodes;
+  const std::vector<long>& b = routes[r2].nodes;
+  long la = a.size(), lb = b.size();
+  long u = a[i];
+  long added[6] = {b[j], u, u, b[j + 1], a[i - 1], a[i + 1]};
+  Move move;
+  move.type = Relocate;
+  move.r1 = r1;
+  move.i = i;
+  move.r2 = r2;
+  move.j = j;
+
+  if (r1 != r2) {
+    Segment before[2] = {whole(r1), whole(r2)};
+    Segment after[2] = {join(sub(r1, 0, i - 1), sub(r1, i + 1, la - 1)),
+                        join(join(sub(r2, 0, j), units[u]), sub(r2, j + 1, lb - 1))};
+    consider(worker, move, before, after, 2, added, 6);
+    return;
+  }
+  Segment after;
+  if (j > i)
+    after = join(join(join(sub(r1, 0, i - 1), sub(r1, i + 1, j)), units[u]), sub(r1, j + 1, la - 1));
+  else
+    after = join(join(join(sub(r1, 0, j), units[u]), sub(r1, j + 1, i - 1)), sub(r1, i + 1, la - 1));
+  consider(worker, move, &whole(r1), &after, 1, added, 6);
+}
+
+void VRPTabuSearch::evaluateSwap(Worker& worker, long r1, long i, long r2, long j) const {
+  const std::vector<long>& a = routes[r1].nodes;
+  const std::vector<long>& b = routes[r2].nodes;
+  long la = a.size(), lb = b.size();
+  long u = a[i], v = b[j];
+  long added[8] = {a[i - 1], v, v, a[i + 1], b[j - 1], u, u, b[j + 1]};
+  Move move;
+  move.type = Swap;
+  move.r1 = r1;
+  move.i = i;
+  move.r2 = r2;
+  move.j = j;
+  Segment before[2] = {whole(r1), whole(r2)};
+  Segment after[2] = {join(join(sub(r1, 0, i - 1), units[v]), sub(r1, i + 1, la - 1)),
+                      join(join(sub(r2, 0, j - 1), units[u]), sub(r2, j + 1, lb - 1))};
+  consider(worker, move, before, after, 2, added, 8);
+}
+
+void VRPTabuSearch::evaluateTwoOptStar(Worker& worker, long r1, long i, long r2, long j) const {
+  const std::vector<long>& a = routes[r1].nodes;
+  const std::vector<long>& b = routes[r2].nodes;
+  long la = a.size(), lb = b.size();
+  long added[4] = {a[i], b[j], b[j - 1], a[i + 1]};
+  Move move;
+  move.type = TwoOptStar;
+  move.r1 = r1;
+  move.i = i;
+  move.r2 = r2;
+  move.j = j;
+  Segment before[2] = {whole(r1), whole(r2)};
+  Segment after[2] = {join(sub(r1, 0, i), sub(r2, j, lb - 1)),
+                      join(sub(r2, 0, j - 1), sub(r1, i + 1, la - 1))};
+  consider(worker, move, before, after, 2, added, 4);
+}
+
+// Every move that adds an edge between u and one of its candidates, and
+// the moves of u to either end of a route.
+void VRPTabuSearch::evaluateCustomer(Worker& worker, long u) const {
+  worker.order = (long long)u << 24;
+  long r1 = route_of[u], i = position_of[u];
+  const long* cand = neighbours.data() + u * k;
+  for (long m = 0; m < k; m++) {
+    long v = cand[m];
+    long r2 = route_of[v], j = position_of[v];
+    evaluateRelocate(worker, r1, i, r2, j);
+    evaluateRelocate(worker, r1, i, r2, j - 1);
+    if (r1 == r2)
+      continue;
+    evaluateSwap(worker, r1, i, r2, j);
+    evaluateTwoOptStar(worker, r1, i, r2, j);
+    evaluateTwoOptStar(worker, r2, j, r1, i);
+  }
+
+  for (long r2 = 0; r2 < (long)routes.size(); r2++) {
+    long length = routes[r2].nodes.size();
+    if (length == 2) {
+      if (r2 == first_empty)
+        evaluateRelocate(worker, r1, i, r2, 0);
+      continue;
+    }
+    evaluateRelocate(worker, r1, i, r2, 0);
+    evaluateRelocate(worker, r1, i, r2, length - 2);
+  }
+}
+
+void VRPTabuSearch::apply(const Move& move) {
+  std::vector<long>& a = routes[move.r1].nodes;
+  std::vector<long>& b = routes[move.r2].nodes;
+  long i = move.i, j = move.j;
+  long removed[8];
+  long removed_count = 0;
+
+  if (move.type == Relocate) {
+    long u = a[i];
+    long edges[6] = {a[i - 1], u, u, a[i + 1], b[j], b[j + 1]};
+    std::copy(edges, edges + 6, removed);
+    removed_count = 6;
+    a.erase(a.begin() + i);
+    if (move.r1 == move.r2 && j > i)
+      j--;
+    b.insert(b.begin() + j + 1, u);
+  }
+  else if (move.type == Swap) {
+    long edges[8] = {a[i - 1], a[i], a[i], a[i + 1], b[j - 1], b[j], b[j], b[j + 1]};
+    std::copy(edges, edges + 8, removed);
+    removed_count = 8;
+    std::swap(a[i], b[j]);
+  }
+  else {
+    long edges[4] = {a[i], a[i + 1], b[j - 1], b[j]};
+    std::copy(edges, edges + 4, removed);
+    removed_count = 4;
+    std::vector<long> head(a.begin(), a.begin() + i + 1);
+    head.insert(head.end(), b.begin() + j, b.end());
+    std::vector<long> tail(b.begin(), b.begin() + j);
+    tail.insert(tail.end(), a.begin() + i + 1, a.end());
+    a.swap(head);
+    b.swap(tail);
+  }
+
+  for (long e = 0; e < removed_count; e += 2)
+    tabu.add(removed[e], removed[e + 1], iteration + tenure, iteration);
+  rebuild(move.r1);
+  if (move.r2 != move.r1)
+    rebuild(move.r2);
+  updateTotals();
+  TSP_COUNT(MovesAccepted, 1);
+}
+
+void VRPTabuSearch::run(long iterations, double seconds) {
+  if (size < 2)
+    return;
+  if (routes.empty())
+    createGreedyRoutes();
+  if (!pool)
+    setup();
+  auto start = std::chrono::steady_clock::now();
+  TSP_PHASE(LocalSearch);
+
+  for (long it = 0; iterations < 0 || it < iterations; it++) {
+    if (seconds >= 0) {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() >= seconds)
+        break;
+    }
+
+    for (auto& worker : workers) {
+      worker->best.type = None;
+      worker->evaluated = 0;
+    }
+    pool->parallelFor(1, size, 8, [this](long w, long lo, long hi) {
+      Worker& worker = *workers[w];
+      for (long u = lo; u < hi; u++)
+        evaluateCustomer(worker, u);
+      TSP_COUNT(MovesEvaluated, worker.evaluated);
+      worker.evaluated = 0;
+    });
+
+    const Move* found = nullptr;
+    for (auto& worker : workers) {
+      const Move& move = worker->best;
+      if (move.type == None)
+        continue;
+      if (found == nullptr || move.delta < found->delta ||
+          (move.delta == found->delta && move.order < found->order))
+        found = &move;
+    }
+    if (found == nullptr)
+      break;
+
+    apply(*found);
+    iteration++;
+    recordBest();
+
+    if (penalty_update > 0.0) {
+      double factor = 1.0 + penalty_update;
+      lateness_penalty *= total_warp > kFeasibleEps ? factor : 1.0 / factor;
+      capacity_penalty *= total_overload > kFeasibleEps ? factor : 1.0 / factor;
+      lateness_penalty = std::min(kMaxPenalty, std::max(kMinPenalty, lateness_penalty));
+      capacity_penalty = std::min(kMaxPenalty, std::max(kMinPenalty, capacity_penalty));
+    }
+  }
+}
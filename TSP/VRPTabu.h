@@ -0,0 +1,194 @@
+// Copyright 2020 GHA Test Team
+#ifndef INCLUDE_VRPTABU_H_
+#define INCLUDE_VRPTABU_H_
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+struct VRPCustomer {
+  long id;
+  double x, y;
+  double demand;
+  double ready, due;
+  double service;
+};
+
+// customers[0] is the depot.
+struct VRPInstance {
+  long vehicles = 0;
+  double capacity = 0.0;
+  std::vector<VRPCustomer> customers;
+};
+
+// Reads the TabuSearch/I1.txt format: a "customers vehicles capacity"
+// line, then one "id x y demand ready due service" line per node, depot
+// first. Returns false when the file cannot be opened or has no depot.
+bool readVRPTW(const std::string& file_name, VRPInstance& instance);
+
+
+// Set of tabu edges, open addressing over (min, max) keys. An edge is tabu
+// while the iteration is below its expiry. Expired slots are reused by
+// later inserts instead of being erased, so probe chains never break and
+// add / isTabu are O(1) on average.
+class TabuTable {
+public:
+  void clear();
+  void add(long a, long b, long expiry, long iteration);
+  bool isTabu(long a, long b, long iteration) const;
+
+private:
+  struct Slot {
+    unsigned long long key;
+    long expiry;
+  };
+  std::vector<Slot> slots;
+  long used = 0;
+  int bits = 0;
+
+  static unsigned long long edgeKey(long a, long b);
+  size_t home(unsigned long long key) const;
+  void rehash(int new_bits, long iteration);
+};
+
+
+// Tabu search for the VRP with time windows, a native counterpart of
+// TabuVRP in TabuSearch/TabuSearch.py. The objective is the same (travel
+// time plus unloading), infeasible solutions are allowed and penalized by
+// time warp and capacity overload.
+//
+// Every route keeps the concatenation data (distance, duration, time
+// warp, earliest and latest start, load) of all its subsequences, so the
+// forward prefixes, backward suffixes and the pieces in between are there
+// for any move, and the routes a move creates are evaluated by joining at
+// most four pieces: O(1) per move. The neighbourhood (relocate, swap and
+// 2-opt* between a customer and its nearest customers, plus moves next to
+// the depot) is evaluated in parallel, one chunk of customers per worker.
+// Removed edges stay tabu for `tenure` iterations unless a move gives a
+// new best feasible solution.
+class VRPTabuSearch {
+public:
+  long tenure = 10;
+  long candidates = 20;
+  double lateness_penalty = 1.0;
+  double capacity_penalty = 1.0;
+  // Both penalties are multiplied by 1 + penalty_update while the current
+  // solution violates their constraint and divided by it otherwise; 0
+  // keeps them fixed.
+  double penalty_update = 0.5;
+  // 0 = one worker per hardware thread.
+  long threads = 0;
+
+  explicit VRPTabuSearch(const VRPInstance& instance);
+  ~VRPTabuSearch();
+  VRPTabuSearch(const VRPTabuSearch&) = delete;
+  VRPTabuSearch& operator=(const VRPTabuSearch&) = delete;
+
+  // Nearest feasible next customer, one vehicle after another, like
+  // TabuVRP's greedy decision. Customers left when the vehicles run out go
+  // to the last route.
+  void createGreedyRoutes();
+  // Reads routes in the best_solution.txt format ("0, 20, 25, 0" per line,
+  // customer ids). Returns false unless every customer is visited once.
+  bool loadRoutes(const std::string& file_name);
+  // Writes the best feasible routes in the same format; false when none
+  // was found yet.
+  bool saveRoutes(const std::string& file_name) const;
+
+  // Runs until `iterations` iterations (-1 = no limit) or `seconds`
+  // (-1 = no limit) have passed. Starts from the greedy routes unless
+  // routes were loaded; can be called again to continue.
+  void run(long iterations, double seconds = -1);
+
+  bool hasFeasible() const { return !best_routes.empty(); }
+  // Travel time plus unloading of the best feasible routes.
+  double getBestCost() const;
+  const std::vector<std::vector<long>>& getBestRoutes() const { return best_routes; }
+  // Travel time plus unloading of the current routes, without penalties.
+  double getCurrentCost() const;
+  bool isCurrentFeasible() const;
+
+private:
+  struct Segment {
+    long first, last;
+    double distance;
+    double duration;
+    double time_warp;
+    double earliest, latest;
+    double load;
+  };
+
+  struct Route {
+    std::vector<long> nodes;
+    // segments[i * nodes.size() + j] covers nodes[i..j], i <= j.
+    std::vector<Segment> segments;
+  };
+
+  enum MoveType { None, Relocate, Swap, TwoOptStar };
+
+  // Relocate: the customer at (r1, i) goes after position j of r2.
+  // Swap: the customers at (r1, i) and (r2, j) trade places.
+  // TwoOptStar: r1 keeps nodes[0..i] followed by r2's nodes[j..], r2 keeps
+  // its nodes[0..j-1] followed by r1's nodes[i+1..].
+  struct Move {
+    MoveType type = None;
+    long r1, i, r2, j;
+    double delta;
+    double distance_delta, warp_delta, overload_delta;
+    long long order;
+  };
+
+  struct Worker;
+
+  VRPInstance instance;
+  long size;
+  std::vector<double> dist;
+  std::vector<long> neighbours;
+  long k = 0;
+  std::vector<Segment> units;
+  double service_total = 0.0;
+
+  std::vector<Route> routes;
+  std::vector<long> route_of;
+  std::vector<long> position_of;
+  double total_distance = 0.0, total_warp = 0.0, total_overload = 0.0;
+  long first_empty = -1;
+
+  TabuTable tabu;
+  long iteration = 0;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  std::vector<std::vector<long>> best_routes;
+  double best_distance;
+
+  double distance(long a, long b) const { return dist[a * size + b]; }
+  Segment join(const Segment& a, const Segment& b) const;
+  const Segment& sub(long r, long i, long j) const {
+    const Route& route = routes[r];
+    return route.segments[i * route.nodes.size() + j];
+  }
+  const Segment& whole(long r) const { return sub(r, 0, routes[r].nodes.size() - 1); }
+  double overload(const Segment& s) const { return std::max(0.0, s.load - instance.capacity); }
+  double penalized(const Segment& s) const {
+    return s.distance + lateness_penalty * s.time_warp + capacity_penalty * overload(s);
+  }
+
+  void setup();
+  void setRoutes(const std::vector<std::vector<long>>& new_routes);
+  void rebuild(long r);
+  void updateTotals();
+  void recordBest();
+
+  void evaluateCustomer(Worker& worker, long u) const;
+  void evaluateRelocate(Worker& worker, long r1, long i, long r2, long j) const;
+  void evaluateSwap(Worker& worker, long r1, long i, long r2, long j) const;
+  void evaluateTwoOptStar(Worker& worker, long r1, long i, long r2, long j) const;
+  void consider(Worker& worker, Move& move, const Segment* before, const Segment* after,
+                long count, const long* added, long added_count) const;
+  void apply(const Move& move);
+};
+
+#endif  // INCLUDE_VRPTABU_H_
@@ -0,0 +1,336 @@
+// Copyright 2020 GHA Test Team
+#include "TSPAlgorithm.h"
+#include "InstanceGenerator.h"
+#include "Instrumentation.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Runs the engine on the TSPLIB instances of TSP_Santa and on generated
+// instances and prints one JSON document with a record per run:
+//
+//   benchmark [--data DIR] [--seconds S] [--gap G] [--seed N]
+//             [--sizes N,N,...] [--lin-kernighan] [--no-tsplib] [--out FILE]
+//             [--metrics FILE] [--reference-seconds R] [--references FILE]
+//
+// Every run builds the candidate lists and a greedy edge tour, then runs
+// one iteratedKickSearch for S seconds, which records the time of every
+// new best tour. time_to_target is the first time (from the start of the
+// construction) at which the tour was within G of the reference cost: the
+// optimum for the TSPLIB instances, the Beardwood-Halton-Hammersley
+// estimate 0.7124 * sqrt(n * area) for uniform ones and, for clustered
+// ones, whose length the estimate does not predict, the cost reached by a
+// reference run: Or-opt and Lin-Kernighan kicks for R seconds (60 by
+// default) with settings that do not depend on the other options. With
+// --references the reference costs are kept in FILE ("name seed cost"
+// lines) and only computed for instances it does not list yet, so that
+// separate invocations compare against the same value; delete the file to
+// recompute them.
+//
+// process_peak_rss_kb is the high-water mark of the whole process when the
+// run ended, so it covers the earlier runs too. rss_delta_kb is how much
+// the resident size grew from the start of the run to its end, with the
+// distances, candidate lists, tour and search buffers still alive; heap
+// pages freed by an earlier run and reused by this one do not count, so
+// for a per-run peak run one instance per invocation (--no-tsplib
+// --sizes N).
+//
+// --metrics dumps the instrumentation counters to FILE every second
+// (Prometheus text for a .prom file, JSON otherwise); they stay zero
+// unless the engine is built with -DTSP_INSTRUMENTATION.
+
+struct Options {
+  std::string data_dir = "../TSP_Santa/";
+  double seconds = 10.0;
+  double gap = 0.05;
+  unsigned long long seed = 1;
+  std::vector<long> sizes = { 1000, 10000, 100000 };
+  bool lin_kernighan = false;
+  bool tsplib = true;
+  std::string out;
+  std::string metrics;
+  double reference_seconds = 60.0;
+  std::string references;
+};
+
+struct Instance {
+  std::string name;
+  std::string kind;
+  std::vector<node_info> data;
+  EdgeWeightType type = EdgeWeightType::RAW;
+  double reference = 0.0;
+  std::string reference_kind;
+};
+
+struct Run {
+  double construction_seconds = 0.0;
+  double search_seconds = 0.0;
+  double initial_cost = 0.0;
+  double final_cost = 0.0;
+  double reference = 0.0;
+  double time_to_target = -1.0;
+  long long moves_evaluated = 0;
+  long process_peak_rss_kb = -1;
+  long rss_delta_kb = 0;
+};
+
+// Peak resident set size of the process so far, -1 when unknown. It never
+// goes down, so it is not a per-run figure.
+static long peakRssKb() {
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+// Current resident set size, -1 when unknown (only read on Linux).
+static long currentRssKb() {
+#ifndef _WIN32
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0, resident = 0;
+  if (statm >> pages >> resident)
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+  return -1;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static Run runInstance(const Instance& instance, const Options& options) {
+  Run run;
+  long n = instance.data.size();
+  long rss_before = currentRssKb();
+
+  std::unique_ptr<DistanceProvider> distance(makeDistance(instance.data, instance.type));
+  TSP tsp(distance.get(), n);
+  tsp.random = Random(options.seed);
+  tsp.use_candidates = true;
+  tsp.use_or_opt = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_lin_kernighan = options.lin_kernighan;
+
+  auto start = std::chrono::steady_clock::now();
+  tsp.buildCandidateLists(instance.data, 8);
+  tsp.createGreedyEdgeTour(instance.data, 8);
+  run.construction_seconds = secondsSince(start);
+  run.initial_cost = tsp.getPathCost();
+
+  // (seconds since the start of the search, cost) at every new best.
+  std::vector<std::pair<double, double>> trace;
+  tsp.best_trace = &trace;
+  auto search_start = std::chrono::steady_clock::now();
+  tsp.iteratedKickSearch(nullptr, "", -1, options.seconds);
+  run.search_seconds = secondsSince(search_start);
+  tsp.best_trace = nullptr;
+  trace.insert(trace.begin(), std::make_pair(0.0, run.initial_cost));
+  run.final_cost = tsp.getPathCost();
+  run.moves_evaluated = tsp.getMovesEvaluated();
+  run.process_peak_rss_kb = peakRssKb();
+  long rss_after = currentRssKb();
+  run.rss_delta_kb = rss_before < 0 || rss_after < 0 ? -1 : rss_after - rss_before;
+
+  run.reference = instance.reference;
+  for (const auto& point : trace) {
+    if (point.second <= run.reference * (1.0 + options.gap)) {
+      run.time_to_target = run.construction_seconds + point.first;
+      break;
+    }
+  }
+  return run;
+}
+
+// Cost of the best tour of a long run with fixed settings, the reference
+// for instances without a known optimum or estimate.
+static double referenceCost(const Instance& instance, const Options& options) {
+  long n = instance.data.size();
+  std::unique_ptr<DistanceProvider> distance(makeDistance(instance.data, instance.type));
+  TSP tsp(distance.get(), n);
+  tsp.random = Random(options.seed, 1);
+  tsp.use_candidates = true;
+  tsp.use_or_opt = true;
+  tsp.use_dont_look_bits = true;
+  tsp.use_lin_kernighan = true;
+  tsp.buildCandidateLists(instance.data, 8);
+  tsp.createGreedyEdgeTour(instance.data, 8);
+  tsp.iteratedKickSearch(nullptr, "", -1, options.reference_seconds);
+  return tsp.getPathCost();
+}
+
+static std::string referenceKey(const std::string& name, unsigned long long seed) {
+  return name + " " + std::to_string(seed);
+}
+
+static std::map<std::string, double> readReferences(const std::string& file_name) {
+  std::map<std::string, double> references;
+  std::ifstream in(file_name);
+  std::string name;
+  unsigned long long seed;
+  double cost;
+  while (in >> name >> seed >> cost)
+    references[referenceKey(name, seed)] = cost;
+  return references;
+}
+
+static void writeRun(std::ostream& out, const Instance& instance, const Options& options, const Run& run) {
+  double moves_per_second = run.search_seconds > 0 ? run.moves_evaluated / run.search_seconds : 0.0;
+  out << "    {\"instance\": \"" << instance.name << "\""
+      << ", \"kind\": \"" << instance.kind << "\""
+      << ", \"cities\": " << instance.data.size()
+      << ", \"construction_seconds\": " << run.construction_seconds
+      << ", \"search_seconds\": " << run.search_seconds
+      << ", \"initial_cost\": " << run.initial_cost
+      << ", \"final_cost\": " << run.final_cost
+      << ", \"reference_cost\": " << run.reference
+      << ", \"reference_kind\": \"" << instance.reference_kind << "\""
+      << ", \"final_gap\": " << run.final_cost / run.reference - 1.0
+      << ", \"target_gap\": " << options.gap
+      << ", \"time_to_target_seconds\": ";
+  if (run.time_to_target < 0)
+    out << "null";
+  else
+    out << run.time_to_target;
+  out << ", \"moves_evaluated\": " << run.moves_evaluated
+      << ", \"moves_per_second\": " << moves_per_second
+      << ", \"process_peak_rss_kb\": " << run.process_peak_rss_kb
+      << ", \"rss_delta_kb\": " << run.rss_delta_kb << "}";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (!std::strcmp(argv[i], "--data") && has_value)
+      options.data_dir = argv[++i];
+    else if (!std::strcmp(argv[i], "--seconds") && has_value)
+      options.seconds = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--gap") && has_value)
+      options.gap = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--seed") && has_value)
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (!std::strcmp(argv[i], "--sizes") && has_value) {
+      options.sizes.clear();
+      std::stringstream list(argv[++i]);
+      std::string size;
+      while (std::getline(list, size, ','))
+        if (!size.empty())
+          options.sizes.push_back(std::atol(size.c_str()));
+    }
+    else if (!std::strcmp(argv[i], "--lin-kernighan"))
+      options.lin_kernighan = true;
+    else if (!std::strcmp(argv[i], "--no-tsplib"))
+      options.tsplib = false;
+    else if (!std::strcmp(argv[i], "--out") && has_value)
+      options.out = argv[++i];
+    else if (!std::strcmp(argv[i], "--metrics") && has_value)
+      options.metrics = argv[++i];
+    else if (!std::strcmp(argv[i], "--reference-seconds") && has_value)
+      options.reference_seconds = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--references") && has_value)
+      options.references = argv[++i];
+    else
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "usage: benchmark [--data DIR] [--seconds S] [--gap G] [--seed N]"
+              << " [--sizes N,N,...] [--lin-kernighan] [--no-tsplib] [--out FILE]"
+              << " [--metrics FILE] [--reference-seconds R] [--references FILE]" << std::endl;
+    return 2;
+  }
+
+  std::unique_ptr<MetricsExporter> exporter;
+  if (!options.metrics.empty()) {
+    bool prometheus = options.metrics.size() >= 5 &&
+                      options.metrics.compare(options.metrics.size() - 5, 5, ".prom") == 0;
+    exporter.reset(new MetricsExporter(options.metrics, prometheus ? MetricsExporter::Format::Prometheus
+                                                                   : MetricsExporter::Format::Json, 1.0));
+  }
+
+  std::map<std::string, double> references;
+  if (!options.references.empty())
+    references = readReferences(options.references);
+
+  std::vector<Instance> instances;
+  if (options.tsplib) {
+    const std::pair<const char*, double> known[] = {
+      { "dj38", 6656.0 }, { "lu980", 11340.0 }, { "ar9152", 837479.0 } };
+    for (const auto& entry : known) {
+      TSPLibInstance file;
+      if (!readTSPLib(options.data_dir + entry.first + ".tsp", file)) {
+        std::cerr << "skipping " << entry.first << ": cannot read it from " << options.data_dir << std::endl;
+        continue;
+      }
+      Instance instance;
+      instance.name = entry.first;
+      instance.kind = "tsplib";
+      instance.data.swap(file.nodes);
+      // The optima are for EUC_2D. ar9152 declares it, but dj38 and lu980
+      // are bare coordinate lists in TSP_Santa, so all three are set here.
+      instance.type = EdgeWeightType::EUC_2D;
+      instance.reference = entry.second;
+      instance.reference_kind = "optimum";
+      instances.push_back(instance);
+    }
+  }
+  for (long n : options.sizes) {
+    const double side = 1000000.0;
+    Instance uniform;
+    uniform.name = "uniform-" + std::to_string(n);
+    uniform.kind = "uniform";
+    uniform.data = generateUniform(n, options.seed, side);
+    uniform.reference = 0.7124 * std::sqrt(n * side * side);
+    uniform.reference_kind = "bhh_estimate";
+    instances.push_back(uniform);
+
+    Instance clustered;
+    clustered.name = "clustered-" + std::to_string(n);
+    clustered.kind = "clustered";
+    clustered.data = generateClustered(n, std::max(1L, n / 100), options.seed, side);
+    clustered.reference_kind = "reference_run";
+    std::string key = referenceKey(clustered.name, options.seed);
+    if (references.count(key) == 0) {
+      std::cerr << clustered.name << ": computing the reference cost" << std::endl;
+      references[key] = referenceCost(clustered, options);
+      if (!options.references.empty()) {
+        std::ofstream out(options.references, std::ios::app);
+        out.precision(17);
+        out << key << " " << references[key] << "\n";
+      }
+    }
+    clustered.reference = references[key];
+    instances.push_back(clustered);
+  }
+
+  std::ostringstream json;
+  json.precision(12);
+  json << "{\n  \"seed\": " << options.seed << ", \"seconds\": " << options.seconds
+       << ", \"lin_kernighan\": " << (options.lin_kernighan ? "true" : "false") << ",\n  \"runs\": [\n";
+  for (size_t i = 0; i < instances.size(); i++) {
+    Run run = runInstance(instances[i], options);
+    writeRun(json, instances[i], options, run);
+    json << (i + 1 < instances.size() ? ",\n" : "\n");
+    std::cerr << instances[i].name << ": " << run.final_cost << std::endl;
+  }
+  json << "  ]\n}\n";
+
+  if (options.out.empty())
+    std::cout << json.str();
+  else
+    std::ofstream(options.out) << json.str();
+  return 0;
+}
@@ -1,58 +1,25 @@
 #include "TSPAlgorithm.h"
-#include <Windows.h>
+#include "ResultsStore.h"
 
 
-std::string findMinResult() {
-  WIN32_FIND_DATAW wfd;
-
-  std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Mona\\";
-
-  HANDLE const hFind = FindFirstFileW(L"C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Mona\\*Result*", &wfd);
-
-  double best_cost = std::numeric_limits<double>::infinity();
-  std::string best_file_name;
-
-  if (INVALID_HANDLE_VALUE != hFind)
-  {
-    do
-    {
-      std::wstring ws(&wfd.cFileName[0]);
-      std::string file_name(ws.begin(), ws.end());
-      std::ifstream file(dir_name + file_name);
-      std::string str;
-
-      char min_cost[50] = { '\0' };
-      std::getline(file, str);
-      int i = str.size() - 1, j = 0;
-      while (str[i] != ' ') {
-        min_cost[j++] = str[i--];
-      }
-      int dec = 0, size = j - 1;
-      char reverse_cost[50] = { '\0' };
-      for (int i = 0; i <= size; i++) {
-        reverse_cost[i] = min_cost[size - dec];
-        dec++;
-      }
-
-      double cost = std::atof(reverse_cost);
-
-      if (cost < best_cost) {
-        best_cost = cost;
-        best_file_name = file_name;
-      }
-    } while (NULL != FindNextFileW(hFind, &wfd));
-
-    FindClose(hFind);
-  }
-
-  return best_file_name;
+// Best run recorded for the instance, empty when there is none.
+std::string findMinResult(const std::string& dir_name, const std::string& instance) {
+  ResultsStore store(dir_name, instance);
+  ResultsStore::Entry best;
+  if (!store.best(best))
+    return "";
+  return "start " + std::to_string(best.start) + " COST: " + std::to_string(best.cost);
 }
 
 void FinderMona() {
   DataReader reader("mona_1000.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Mona\\";
+  ResultsStore store(dir_name, "mona_1000");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 2, 1000, -1);
   //std::thread t1(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 2, 1000, -1);
   //t1.join();
@@ -60,18 +27,26 @@ void FinderMona() {
 
 void FinderLu() {
   DataReader reader("lu980.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Lu980\\";
+  ResultsStore store(dir_name, "lu980");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 0, 980, -1);
   //std::thread t2(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 0, 980, -1);
 }
 
 void FinderJa() {
   DataReader reader("ja_1000.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Ja1000\\";
+  ResultsStore store(dir_name, "ja_1000");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 0, 1000, -1);
   //std::thread t3(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 0, 1000, -1);
   //t3.join();
@@ -79,18 +54,26 @@ void FinderJa() {
 
 void FinderRandom1() {
   DataReader reader("random_1.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Random1\\";
+  ResultsStore store(dir_name, "random_1");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 0, 703, -1);
   //std::thread t4(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 0, 703, -1);
 }
 
 void FinderRandom2() {
   DataReader reader("random_2.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Random2\\";
+  ResultsStore store(dir_name, "random_2");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 0, 703, -1);
   //std::thread t5(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 0, 703, -1);
   //t5.join();
@@ -98,9 +81,13 @@ void FinderRandom2() {
 
 void FinderRandom3() {
   DataReader reader("random_3.txt");
+  if (!reader.loaded)
+    return;
   TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   tsp.first_step = false;
   std::string dir_name = "C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Random3\\";
+  ResultsStore store(dir_name, "random_3");
+  tsp.results = &store;
   tsp.randomNodeStarter(&reader, "Result.txt", dir_name, 0, 990, -1);
   //std::thread t6(&TSP::randomNodeStarter, tsp, &reader, "Result.txt", dir_name, 0, 990, -1);
   //t6.join();
@@ -132,7 +119,7 @@ int main() {
   //TSP tsp(reader.dist_matrix, reader.dist_pseudo_matrix, reader.node_num);
   //tsp.first_step = false;
 
-  // std::cout << "BEST RESULT: " << findMinResult() << std::endl;
+  // std::cout << "BEST RESULT: " << findMinResult("C:\\Users\\user\\source\\repos\\Local Search\\Local Search\\Mona\\", "mona_1000") << std::endl;
 
   // tsp.randomNodeStarter(&reader, "Result.txt", 122, 123, -1);
   //tsp.finBestGreedy(1000);
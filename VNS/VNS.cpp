@@ -14,6 +14,7 @@ VNS::VNS() {
   machines = parts = all_ones = clustersNum = 0;
 }
 VNS::VNS(std::string file_name, bool findGreedy) {
+  all_ones = clustersNum = 0;
   ReadData(file_name);
   if (findGreedy){
     unsigned targetClustersNum = std::min(machines, parts);
@@ -618,9 +619,8 @@ void VNS::DivideClusters(bool findBest){
   }
   
   if (!findBest && allValidClusters.size() != 0){
-    srand (time(NULL));
-    unsigned random = rand() % allValidClusters.size();
-    best_c = allValidClusters[random];
+    unsigned chosen = random.below(allValidClusters.size());
+    best_c = allValidClusters[chosen];
   }
   
   // implement changes
@@ -693,8 +693,7 @@ void VNS::MergeClusters(bool findBest) {
     unsigned* clustersArray = new unsigned[clustersNum];
     for (int i = 0; i < clustersNum; i++)
       clustersArray[i] = i + 1;
-    std::srand(time(NULL) + rand());
-    std::random_shuffle<unsigned int *>(&clustersArray[0], &clustersArray[clustersNum], RNG());
+    std::shuffle(&clustersArray[0], &clustersArray[clustersNum], random);
     
     //std::cout << "Clusters shuffle: "<< std::endl;
     //for (int i = 0; i < clustersNum; i++)
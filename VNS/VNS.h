@@ -9,12 +9,7 @@
 #include <vector>
 #include <time.h>
 #include <algorithm>
-
-struct RNG {
-  int operator() (int n) {
-    return std::rand() / (1.0 + RAND_MAX) * n;
-  }
-};
+#include "../TSP/Random.h"
 
 struct RowsPair {
   unsigned i, j;
@@ -44,6 +39,9 @@ private:
                      unsigned* targetVectorSolution, unsigned& size);
   std::vector <void(*)()> neighbours;
   void GetShakingNeighbours(bool, int, int);
+  // Random choices of the shakes. Seeded with 1; VNS objects run in
+  // parallel should get different streams of one seed (Random::split).
+  Random random;
 
 public:
   VNS();
@@ -55,6 +53,7 @@ public:
   unsigned* GetPartsSolution() const;
   bool** GetMatrix() const;
   double GetBestTarget() const { return bestTarget; }
+  void SetRandom(const Random& newRandom) { random = newRandom; }
 
   void PrintMatrix();
   void PrintMachinesSolution(unsigned* targetSoultion = nullptr);